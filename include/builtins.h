@@ -11,4 +11,5 @@
  */
 
 void load_builtins();
+struct regexp *regcache( const char *pattern );
 
@@ -0,0 +1,16 @@
+/*
+ * Copyright 1993-2002 Christopher Seiwald and Perforce Software, Inc.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * cache.h - reuse the outputs of actions run before, from $(JAMCACHE)
+ */
+
+typedef struct _cachekey CACHEKEY;
+
+CACHEKEY *cache_key( TARGET *t, CMD *cmds );
+int cache_fetch( CACHEKEY *k );
+void cache_store( CACHEKEY *k );
+void cache_free( CACHEKEY *k );
@@ -15,6 +15,7 @@
  *	ACTIONS must be combined if 'actions together' is given.
  *	ACTIONS must be split if 'actions piecemeal' is given.
  *	ACTIONS must have current sources omitted for 'actions updated'.
+ *	ACTIONS get their sources in a file for 'actions response'.
  *
  * The CMD datatype holds a single command that is to be executed 
  * against a target, and they can chain together to represent the 
@@ -28,6 +29,7 @@
  *
  * 	cmd_new() - return a new CMD or 0 if too many args
  *	cmd_free() - delete CMD and its parts
+ *	cmd_rsp() - write the response file for 'actions response'
  *	cmd_next() - walk the CMD chain
  */
 
@@ -43,8 +45,12 @@ struct _cmd
 	CMD	*tail;		/* valid on in head */
 	RULE	*rule;		/* rule->actions contains shell script */
 	LIST	*shell;		/* $(SHELL) value */
-	LOL	args;		/* LISTs for $(<), $(>) */
+	LOL	args;		/* $(<), and $(>) for a jamworker */
 	char	*buf;		/* actual commands */
+	long	start;		/* history_clock() when launched */
+	long	rss;		/* expected peak KB, while running */
+	LIST	*rsp;		/* real $(>), for 'actions response' */
+	char	*rspfile;	/* where cmd_rsp() writes them */
 } ;
 
 CMD *cmd_new(
@@ -55,5 +61,6 @@ CMD *cmd_new(
 	int	maxline );	/* max line length */
 
 void cmd_free( CMD *cmd );
+int cmd_rsp( CMD *cmd );
 
 # define cmd_next( c ) ((c)->next)
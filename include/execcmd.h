@@ -12,14 +12,21 @@
  */
 
 int execmax();
+int execcpus();
+int execload();
 
 void execcmd(
 	char *string,
 	void (*func)( void *closure, int status ),
 	void *closure,
-	LIST *shell );
+	LIST *shell,
+	LOL *args );
 
 int execwait();
+int execpoll();
+int execready();
+int execexit();
+long execrss();
 
 # define EXEC_CMD_OK	0
 # define EXEC_CMD_FAIL	1
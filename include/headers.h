@@ -9,3 +9,5 @@
  */
 
 void headers( TARGET *t );
+void headers_prefetch( TARGET *t );
+void doneheaders();
@@ -0,0 +1,33 @@
+/*
+ * Copyright 1993-2002 Christopher Seiwald and Perforce Software, Inc.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * history.h - remember how actions went on previous runs
+ */
+
+typedef struct _history HISTORY;
+
+struct _history {
+	const char	*name;		/* "rule target" */
+	long		ms;		/* wall time of last run */
+	int		status;		/* EXEC_CMD_OK/FAIL of last run */
+	long		rss;		/* peak KB of last run, 0 if unknown */
+	unsigned long	hash;		/* of the command text */
+	int		ran;		/* 1 if recorded this run */
+} ;
+
+void history_init();
+HISTORY *history_find( const char *rule, const char *target );
+HISTORY *history_record( const char *rule, const char *target,
+		long ms, int status, long rss, const char *buf );
+long history_cost( const char *rule, const char *target );
+long history_rss( const char *rule, const char *target );
+long history_clock();
+int history_known();
+time_t history_since();
+time_t history_restat( const char *target, time_t mtime );
+void history_unchanged( const char *target, time_t mtime, time_t when );
+void history_done();
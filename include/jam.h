@@ -542,18 +542,22 @@
 # define MAXSYM	1024	/* longest symbol in the environment */
 # define MAXJPATH 1024	/* longest filename */
 
-# define MAXJOBS 64	/* silently enforce -j limit */
 # define MAXARGC 32	/* words in $(JAMSHELL) */
 
 /* Jam private definitions below. */
 
-# define DEBUG_MAX	15
+# define DEBUG_MAX	16
 
 struct globs {
 	int	noexec;
 	int	jobs;
+	int	jobsset;		/* -j given */
 	int	quitquick;
+	int	anyhow;			/* build all targets (-a) */
 	int	newestfirst;		/* build newest sources first */
+	double	maxload;		/* -l: hold off over this load */
+	int	maxpressure;		/* -p: or this % CPU/mem pressure */
+	long	maxmem;			/* -m: KB for running actions */
 	char	debug[DEBUG_MAX];
 	FILE	*cmdout;		/* print cmds, not run them */
 } ;
@@ -583,3 +587,4 @@ extern struct globs globs;
 # define DEBUG_EXEC	( globs.debug[ 12 ] )	/* -dx show text of actions */
 # define DEBUG_DEPENDS	( globs.debug[ 13 ] )	/* -dd show dependency graph */
 # define DEBUG_CAUSES	( globs.debug[ 14 ] )	/* -dc show dependency graph */
+# define DEBUG_TIMES	( globs.debug[ 15 ] )	/* -dt show action times */
@@ -20,32 +20,35 @@
 #define _LBRACKET_t 272
 #define _RBRACKET_t 273
 #define ACTIONS_t 274
-#define BIND_t 275
-#define BREAK_t 276
-#define CASE_t 277
-#define CONTINUE_t 278
-#define DEFAULT_t 279
-#define ELSE_t 280
-#define EXISTING_t 281
-#define FOR_t 282
-#define IF_t 283
-#define IGNORE_t 284
-#define IN_t 285
-#define INCLUDE_t 286
-#define LOCAL_t 287
-#define MAXLINE_t 288
-#define ON_t 289
-#define PIECEMEAL_t 290
-#define QUIETLY_t 291
-#define RETURN_t 292
-#define RULE_t 293
-#define SWITCH_t 294
-#define TOGETHER_t 295
-#define UPDATED_t 296
-#define WHILE_t 297
-#define _LBRACE_t 298
-#define _BAR_t 299
-#define _BARBAR_t 300
-#define _RBRACE_t 301
-#define ARG 302
-#define STRING 303
+#define BATCH_t 275
+#define BIND_t 276
+#define BREAK_t 277
+#define CASE_t 278
+#define CONTINUE_t 279
+#define DEFAULT_t 280
+#define ELSE_t 281
+#define EXISTING_t 282
+#define FOR_t 283
+#define IF_t 284
+#define IGNORE_t 285
+#define IN_t 286
+#define INCLUDE_t 287
+#define LOCAL_t 288
+#define MAXLINE_t 289
+#define ON_t 290
+#define PIECEMEAL_t 291
+#define QUIETLY_t 292
+#define RESPONSE_t 293
+#define RESTAT_t 294
+#define RETURN_t 295
+#define RULE_t 296
+#define SWITCH_t 297
+#define TOGETHER_t 298
+#define UPDATED_t 299
+#define WHILE_t 300
+#define _LBRACE_t 301
+#define _BAR_t 302
+#define _BARBAR_t 303
+#define _RBRACE_t 304
+#define ARG 305
+#define STRING 306
@@ -16,6 +16,7 @@
 	{ "[", _LBRACKET_t },
 	{ "]", _RBRACKET_t },
 	{ "actions", ACTIONS_t },
+	{ "batch", BATCH_t },
 	{ "bind", BIND_t },
 	{ "break", BREAK_t },
 	{ "case", CASE_t },
@@ -33,6 +34,8 @@
 	{ "on", ON_t },
 	{ "piecemeal", PIECEMEAL_t },
 	{ "quietly", QUIETLY_t },
+	{ "response", RESPONSE_t },
+	{ "restat", RESTAT_t },
 	{ "return", RETURN_t },
 	{ "rule", RULE_t },
 	{ "switch", SWITCH_t },
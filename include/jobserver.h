@@ -0,0 +1,14 @@
+/*
+ * Copyright 1993-2002 Christopher Seiwald and Perforce Software, Inc.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * jobserver.h - share a -j budget with make(1) through its jobserver
+ */
+
+void jobserver_init();
+int jobserver_take( int running );
+void jobserver_give( int running );
+int jobserver_want( int running );
@@ -12,3 +12,5 @@
 
 int make( int n_targets, const char **targets, int anyhow );
 int make1( TARGET *t );
+void make1early( TARGET *t );
+void make1pool( const char *name, int limit );
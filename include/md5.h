@@ -0,0 +1,25 @@
+/*
+ * Copyright 1993-2002 Christopher Seiwald and Perforce Software, Inc.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * md5.h - RSA Data Security, Inc. MD5 Message-Digest Algorithm (RFC 1321)
+ */
+
+typedef struct _md5ctx MD5CTX;
+
+struct _md5ctx {
+	unsigned long	state[4];	/* A, B, C, D */
+	unsigned long	count[2];	/* bits hashed, lsw first */
+	unsigned char	buf[64];	/* partial input block */
+} ;
+
+# define MD5_SIZE	16	/* bytes in a digest */
+
+void md5_init( MD5CTX *ctx );
+void md5_update( MD5CTX *ctx, const void *data, unsigned int len );
+void md5_final( unsigned char digest[ MD5_SIZE ], MD5CTX *ctx );
+int md5_file( const char *path, unsigned char digest[ MD5_SIZE ] );
+void md5_hex( char hex[ 2 * MD5_SIZE + 1 ], unsigned char digest[ MD5_SIZE ] );
@@ -15,11 +15,13 @@ typedef struct regexp {
 	char reganch;		/* Internal use only. */
 	char *regmust;		/* Internal use only. */
 	int regmlen;		/* Internal use only. */
+	struct regvm *regvm;	/* Internal use only. */
 	char program[1];	/* Unwarranted chumminess with compiler. */
 } regexp;
 
 regexp *regcomp( const char *exp );
 int regexec( regexp *prog, const char *string );
+int regliteral( regexp *prog, const char **s );
 void regerror( const char *s );
 
 /*
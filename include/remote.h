@@ -0,0 +1,13 @@
+/*
+ * Copyright 1993-2002 Christopher Seiwald and Perforce Software, Inc.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * remote.h - run commands on jamworker daemons, from $(JAMWORKERS)
+ */
+
+int remote_init();
+int remote_start( int slot, const char *string, LOL *args );
+int remote_done( int slot, int wait, int *status );
@@ -59,7 +59,10 @@ struct _rule {
 # define	RULE_QUIETLY	0x08	/* don't mention it unless verbose */
 # define	RULE_PIECEMEAL	0x10	/* split exec so each $(>) is small */
 # define	RULE_EXISTING	0x20	/* $(>) is pre-exisitng sources only */
-# define	RULE_MAXLINE	0x40	/* cmd specific maxline (last) */
+# define	RULE_RESTAT	0x40	/* prune parents if target unchanged */
+# define	RULE_RESPONSE	0x80	/* pass $(>) in a response file */
+# define	RULE_BATCH	0x100	/* run with others of its rule in one sh */
+# define	RULE_MAXLINE	0x200	/* cmd specific maxline (last) */
 
 } ;
 
@@ -162,6 +165,11 @@ struct _target {
 	int		asynccnt;	/* child deps outstanding */
 	TARGETS		*parents;	/* used by make1() for completion */
 	char		*cmds;		/* type-punned command list */
+	char		*cache;		/* type-punned CACHEKEY, if cached */
+	char		*restat;	/* type-punned RESTAT, if restat */
+	int		critical;	/* make1() priority, 0 until known */
+	char		rank;		/* -q: 2 failed, 1 changed, before critical */
+	const char	*jobpool;	/* $(JOBPOOL) once commands are made */
 } ;
 
 RULE 	*bindrule( const char *rulename );
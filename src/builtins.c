@@ -10,6 +10,7 @@
  * External routines:
  *
  * 	load_builtin() - define builtin rules
+ *	regcache() - compile a regexp, or find it compiled already
  *
  * Internal routines:
  *
@@ -18,6 +19,7 @@
  *	builtin_exit() - EXIT rule
  *	builtin_flags() - NOCARE, NOTFILE, TEMPORARY rule
  *	builtin_glob() - GLOB rule
+ *	builtin_jobpool() - JOBPOOL rule
  *	builtin_match() - MATCH rule
  *
  * 01/10/01 (seiwald) - split from compile.c
@@ -41,6 +43,8 @@
 # include "newstr.h"
 # include "regexp.h"
 # include "pathsys.h"
+# include "make.h"
+# include "hash.h"
 
 /*
  * compile_builtin() - define builtin rules
@@ -54,6 +58,7 @@ LIST *builtin_echo( PARSE *parse, LOL *args, int *jmp );
 LIST *builtin_exit( PARSE *parse, LOL *args, int *jmp );
 LIST *builtin_flags( PARSE *parse, LOL *args, int *jmp );
 LIST *builtin_glob( PARSE *parse, LOL *args, int *jmp );
+LIST *builtin_jobpool( PARSE *parse, LOL *args, int *jmp );
 LIST *builtin_match( PARSE *parse, LOL *args, int *jmp );
 
 int glob( const char *s, const char *c );
@@ -87,6 +92,10 @@ load_builtins()
     bindrule( "INCLUDES" )->procedure = 
 	parse_make( builtin_depends, P0, P0, P0, C0, C0, 1 );
 
+    bindrule( "JobPool" )->procedure = 
+    bindrule( "JOBPOOL" )->procedure = 
+	parse_make( builtin_jobpool, P0, P0, P0, C0, C0, 0 );
+
     bindrule( "Leaves" )->procedure = 
     bindrule( "LEAVES" )->procedure = 
 	parse_make( builtin_flags, P0, P0, P0, C0, C0, T_FLAG_LEAVES );
@@ -210,6 +219,28 @@ builtin_flags(
 	return L0;
 }
 
+/*
+ * builtin_jobpool() - JOBPOOL rule
+ *
+ * The JOBPOOL builtin rule sets how many commands of targets with the
+ * given pool names in their $(JOBPOOL) may run at once.
+ */
+
+LIST *
+builtin_jobpool(
+	PARSE	*parse,
+	LOL	*args,
+	int	*jmp )
+{
+	LIST *l = lol_get( args, 0 );
+	LIST *n = lol_get( args, 1 );
+
+	for( ; l; l = list_next( l ) )
+	    make1pool( l->string, n ? atoi( n->string ) : 1 );
+
+	return L0;
+}
+
 /*
  * builtin_globbing() - GLOB rule
  */
@@ -283,7 +314,7 @@ builtin_match(
 
 	for( l = lol_get( args, 0 ); l; l = l->next )
 	{
-	    regexp *re = regcomp( l->string );
+	    regexp *re = regcache( l->string );
 
 	    /* For each string to match against */
 
@@ -310,9 +341,44 @@ builtin_match(
 		    result = list_new( result, buf, 0 );
 		}
 	    }
-
-	    free( (char *)re );
 	}
 
 	return result;
 }
+
+/*
+ * regcache() - compile a regexp, or find it compiled already
+ *
+ * Regexps are kept compiled by pattern, so that the DFA regexec()
+ * builds up as it goes carries over from one MATCH (or file scanned
+ * for headers) to the next.  A pattern that won't compile is kept as
+ * 0.  Only for the main thread: a regexp's machine isn't shared.
+ */
+
+typedef struct _regcache REGCACHE;
+
+struct _regcache {
+	const char	*pattern;
+	regexp		*re;
+} ;
+
+static struct hash *regexps = 0;
+
+regexp *
+regcache( const char *pattern )
+{
+	REGCACHE r, *rp = &r;
+
+	if( !regexps )
+	    regexps = hashinit( sizeof( REGCACHE ), "regexps" );
+
+	r.pattern = pattern;
+
+	if( hashenter( regexps, (HASHDATA **)&rp ) )
+	{
+	    rp->pattern = newstr( pattern );
+	    rp->re = regcomp( pattern );
+	}
+
+	return rp->re;
+}
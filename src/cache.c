@@ -0,0 +1,544 @@
+/*
+ * Copyright 1993-2002 Christopher Seiwald and Perforce Software, Inc.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * cache.c - reuse the outputs of actions run before, from $(JAMCACHE)
+ *
+ * If $(JAMCACHE) names a directory, make1() looks up each target's
+ * commands there before running them.  The key is an MD5 digest of:
+ *
+ *	the text of each command (after variable expansion), its rule
+ *	name, $(JAMSHELL), and the bound $(<) and $(>) (including those
+ *	passed in a response file);
+ *
+ *	the contents of the target's dependents and the sources of its
+ *	actions, and of all the headers they (transitively) include.
+ *
+ * On a hit, the targets are copied out of the cache and the commands
+ * are not run; otherwise, once the commands succeed, their targets are
+ * copied into the cache under the key.  So switching branches back and
+ * forth, or building in a fresh workspace, needn't rebuild everything.
+ *
+ * Actions whose targets don't stand alone are never cached: 'actions
+ * updated' (the target carries state, like an archive), 'actions
+ * ignore' (the targets may be half made), and NOTFILE targets.
+ *
+ * Each entry is a set of files in $(JAMCACHE)/xx/, where xx are the
+ * first two hex digits of the key: key.0, key.1... hold the targets,
+ * and key itself lists their names.  Files are written under a temp
+ * name and renamed into place, the list last, so that jams sharing
+ * the cache never see a half written entry.
+ *
+ * External routines:
+ *
+ *	cache_key() - compute the cache key for a target's commands
+ *	cache_fetch() - restore a target's outputs from the cache
+ *	cache_store() - save a target's outputs in the cache
+ *	cache_free() - release a cache key
+ *
+ * Internal routines:
+ *
+ *	cache_deps() - digest a dependent and the headers it includes
+ *	cache_digest() - digest the contents of a file, memoized
+ *	cache_path() - form the name of a cache entry file
+ *	cache_copy() - copy a file, by way of a temp name
+ *	cache_mkdir() - make the cache directories for an entry
+ */
+
+# include "jam.h"
+# include "lists.h"
+# include "parse.h"
+# include "variable.h"
+# include "rules.h"
+# include "command.h"
+# include "hash.h"
+# include "newstr.h"
+# include "md5.h"
+# include "cache.h"
+
+# if defined( unix ) || defined( OS_NT )
+# define USE_CACHE
+# endif
+
+# ifdef USE_CACHE
+
+# include <sys/stat.h>
+
+# ifdef OS_NT
+# include <direct.h>
+# include <process.h>
+# define mkdir( d, m ) _mkdir( d )
+# define getpid _getpid
+# else
+# include <unistd.h>
+# endif
+
+struct _cachekey {
+	const char	*dir;		/* $(JAMCACHE) */
+	char		hex[ 2 * MD5_SIZE + 1 ];
+	LIST		*outputs;	/* bound $(<) of all the commands */
+} ;
+
+/* Digests of files, so each is read once per run unless it changes. */
+
+typedef struct {
+	const char	*name;		/* bound name */
+	time_t		mtime;
+	long		size;
+	int		gen;		/* cache_key() that last visited */
+	unsigned char	digest[ MD5_SIZE ];
+} DIGEST ;
+
+/* Internal includes nodes visited, by name. */
+
+typedef struct {
+	const char	*name;
+	int		gen;
+} VISIT ;
+
+static struct hash *digesthash = 0;
+static struct hash *visithash = 0;
+static int gen = 0;
+static time_t started = 0;	/* first cache_key() */
+
+static void cache_deps( MD5CTX *ctx, TARGET *t );
+static DIGEST *cache_digest( const char *path );
+static void cache_path( char *buf, CACHEKEY *k, int n );
+static int cache_copy( const char *from, const char *to );
+static int cache_mkdir( CACHEKEY *k );
+
+/*
+ * cache_key() - compute the cache key for a target's commands
+ *
+ * Returns 0 if $(JAMCACHE) isn't set or the commands can't be cached.
+ */
+
+CACHEKEY *
+cache_key(
+	TARGET	*t,
+	CMD	*cmds )
+{
+	LIST	*dir = var_get( "JAMCACHE" );
+	LIST	*outputs = 0;
+	CACHEKEY *k;
+	ACTIONS	*a;
+	TARGETS	*c;
+	CMD	*cmd;
+	MD5CTX	ctx[1];
+	unsigned char digest[ MD5_SIZE ];
+
+	if( !dir || !*dir->string || globs.noexec || globs.cmdout )
+	    return 0;
+
+	for( a = t->actions; a; a = a->next )
+	{
+	    if( a->action->rule->flags & ( RULE_UPDATED | RULE_IGNORE ) )
+		return 0;
+
+	    for( c = a->action->targets; c; c = c->next )
+		if( c->target->flags & T_FLAG_NOTFILE )
+		    return 0;
+	}
+
+	if( t->flags & T_FLAG_NOTFILE )
+	    return 0;
+
+	/* The commands themselves */
+
+	md5_init( ctx );
+	md5_update( ctx, "jam cache 1", 12 );
+
+	for( cmd = cmds; cmd; cmd = cmd_next( cmd ) )
+	{
+	    LIST *l;
+
+	    md5_update( ctx, cmd->rule->name, strlen( cmd->rule->name ) + 1 );
+	    md5_update( ctx, cmd->buf, strlen( cmd->buf ) + 1 );
+
+	    for( l = cmd->shell; l; l = list_next( l ) )
+		md5_update( ctx, l->string, strlen( l->string ) + 1 );
+
+	    md5_update( ctx, "<", 2 );
+
+	    for( l = lol_get( &cmd->args, 0 ); l; l = list_next( l ) )
+		md5_update( ctx, l->string, strlen( l->string ) + 1 );
+
+	    for( l = cmd->rsp; l; l = list_next( l ) )
+		md5_update( ctx, l->string, strlen( l->string ) + 1 );
+
+	    /* Note the targets, once each */
+
+	    for( l = lol_get( &cmd->args, 0 ); l; l = list_next( l ) )
+	    {
+		LIST *m;
+
+		for( m = outputs; m; m = list_next( m ) )
+		    if( !strcmp( m->string, l->string ) )
+			break;
+
+		if( !m )
+		    outputs = list_new( outputs, l->string, 1 );
+	    }
+	}
+
+	if( !outputs )
+	    return 0;
+
+	/* What they read: dependents, sources, and their headers */
+
+	if( !digesthash )
+	{
+	    digesthash = hashinit( sizeof( DIGEST ), "digests" );
+	    visithash = hashinit( sizeof( VISIT ), "visits" );
+	}
+
+	gen++;
+
+	if( !started )
+	    started = time( 0 );
+
+	for( c = t->depends; c; c = c->next )
+	    cache_deps( ctx, c->target );
+
+	for( a = t->actions; a; a = a->next )
+	    for( c = a->action->sources; c; c = c->next )
+		cache_deps( ctx, c->target );
+
+	md5_final( digest, ctx );
+
+	k = (CACHEKEY *)malloc( sizeof( CACHEKEY ) );
+	k->dir = copystr( dir->string );
+	k->outputs = outputs;
+	md5_hex( k->hex, digest );
+
+	if( DEBUG_MAKEPROG )
+	    printf( "cache\t--\t%s %s\n", k->hex, t->name );
+
+	return k;
+}
+
+/*
+ * cache_deps() - digest a dependent and the headers it includes
+ */
+
+static void
+cache_deps(
+	MD5CTX	*ctx,
+	TARGET	*t )
+{
+	TARGETS	*c;
+
+	/* An internal includes node stands for all the headers */
+	/* included by its file: they (and the headers they include) */
+	/* have been grafted on as its dependents. */
+
+	if( t->flags & T_FLAG_INTERNAL )
+	{
+	    VISIT v, *vp = &v;
+
+	    v.name = t->name;
+
+	    if( hashenter( visithash, (HASHDATA **)&vp ) )
+		vp->name = newstr( t->name );
+	    else if( vp->gen == gen )
+		return;
+
+	    vp->gen = gen;
+
+	    for( c = t->depends; c; c = c->next )
+		cache_deps( ctx, c->target );
+
+	    return;
+	}
+
+	/* NOTFILE targets have no contents, just a name */
+
+	if( t->flags & T_FLAG_NOTFILE || !t->boundname )
+	{
+	    md5_update( ctx, t->name, strlen( t->name ) + 1 );
+	}
+	else
+	{
+	    DIGEST *d = cache_digest( t->boundname );
+
+	    if( d->gen == gen )
+		return;
+
+	    d->gen = gen;
+
+	    md5_update( ctx, t->boundname, strlen( t->boundname ) + 1 );
+	    md5_update( ctx, d->digest, MD5_SIZE );
+	}
+
+	/* A source not among the target's dependents hasn't had its */
+	/* includes grafted onto the target. */
+
+	if( t->includes )
+	    cache_deps( ctx, t->includes );
+}
+
+/*
+ * cache_digest() - digest the contents of a file, memoized
+ *
+ * A file that's missing or not a regular file gets an all zero
+ * digest; its name still goes into the key.  The digest is reused
+ * only while the file looks unchanged and was last written before
+ * this jam started: files written since (say, a header generated by
+ * an earlier action) could change again within the same second.
+ */
+
+static DIGEST *
+cache_digest( const char *path )
+{
+	DIGEST	d, *dp = &d;
+	struct stat sb;
+	int	ok = !stat( path, &sb ) && ( sb.st_mode & S_IFMT ) == S_IFREG;
+
+	d.name = path;
+
+	if( hashenter( digesthash, (HASHDATA **)&dp ) )
+	{
+	    dp->name = newstr( path );
+	    dp->gen = 0;
+	}
+	else if( !ok ? !dp->size && !dp->mtime :
+		dp->mtime == sb.st_mtime && dp->size == (long)sb.st_size &&
+		sb.st_mtime < started )
+	{
+	    return dp;
+	}
+
+	memset( (char *)dp->digest, 0, MD5_SIZE );
+	dp->mtime = ok ? sb.st_mtime : 0;
+	dp->size = ok ? (long)sb.st_size : 0;
+
+	if( ok && md5_file( path, dp->digest ) )
+	    memset( (char *)dp->digest, 0, MD5_SIZE );
+
+	return dp;
+}
+
+/*
+ * cache_fetch() - restore a target's outputs from the cache
+ *
+ * Returns 1 if all of them were restored.
+ */
+
+int
+cache_fetch( CACHEKEY *k )
+{
+	char	path[ MAXJPATH ];
+	char	line[ MAXJPATH + 2 ];
+	LIST	*l;
+	FILE	*f;
+	int	n;
+
+	cache_path( path, k, -1 );
+
+	if( !( f = fopen( path, "r" ) ) )
+	    return 0;
+
+	/* The list must name the same targets. */
+
+	for( l = k->outputs; l; l = list_next( l ) )
+	{
+	    if( !fgets( line, sizeof( line ), f ) )
+		break;
+
+	    line[ strcspn( line, "\n" ) ] = 0;
+
+	    if( strcmp( line, l->string ) )
+		break;
+	}
+
+	fclose( f );
+
+	if( l )
+	    return 0;
+
+	for( n = 0, l = k->outputs; l; n++, l = list_next( l ) )
+	{
+	    cache_path( path, k, n );
+
+	    if( cache_copy( path, l->string ) )
+		return 0;
+	}
+
+	return 1;
+}
+
+/*
+ * cache_store() - save a target's outputs in the cache
+ */
+
+void
+cache_store( CACHEKEY *k )
+{
+	char	path[ MAXJPATH ];
+	char	tmp[ MAXJPATH + 16 ];
+	LIST	*l;
+	FILE	*f;
+	int	n;
+
+	if( cache_mkdir( k ) )
+	    return;
+
+	for( n = 0, l = k->outputs; l; n++, l = list_next( l ) )
+	{
+	    struct stat sb;
+
+	    cache_path( path, k, n );
+
+	    if( stat( l->string, &sb ) || ( sb.st_mode & S_IFMT ) != S_IFREG
+		|| cache_copy( l->string, path ) )
+		    return;
+	}
+
+	/* The list of names goes last: it makes the entry valid. */
+
+	cache_path( path, k, -1 );
+	sprintf( tmp, "%s.%d", path, (int)getpid() );
+
+	if( !( f = fopen( tmp, "w" ) ) )
+	    return;
+
+	for( l = k->outputs; l; l = list_next( l ) )
+	    fprintf( f, "%s\n", l->string );
+
+# ifdef OS_NT
+	unlink( path );
+# endif
+
+	if( fclose( f ) || rename( tmp, path ) )
+	    unlink( tmp );
+}
+
+/*
+ * cache_free() - release a cache key
+ */
+
+void
+cache_free( CACHEKEY *k )
+{
+	freestr( k->dir );
+	list_free( k->outputs );
+	free( (char *)k );
+}
+
+/*
+ * cache_path() - form the name of a cache entry file
+ *
+ * n < 0 is the list of names, otherwise the nth target.
+ */
+
+static void
+cache_path(
+	char	*buf,
+	CACHEKEY *k,
+	int	n )
+{
+	if( strlen( k->dir ) + 2 * MD5_SIZE + 20 > MAXJPATH )
+	    *buf = 0;
+	else if( n < 0 )
+	    sprintf( buf, "%s/%.2s/%s", k->dir, k->hex, k->hex );
+	else
+	    sprintf( buf, "%s/%.2s/%s.%d", k->dir, k->hex, k->hex, n );
+}
+
+/*
+ * cache_mkdir() - make the cache directories for an entry
+ */
+
+static int
+cache_mkdir( CACHEKEY *k )
+{
+	char	path[ MAXJPATH ];
+	struct stat sb;
+
+	if( strlen( k->dir ) + 4 > MAXJPATH )
+	    return -1;
+
+	sprintf( path, "%s/%.2s", k->dir, k->hex );
+
+	if( !stat( path, &sb ) )
+	    return 0;
+
+	mkdir( k->dir, 0777 );
+	mkdir( path, 0777 );
+
+	return stat( path, &sb );
+}
+
+/*
+ * cache_copy() - copy a file, by way of a temp name
+ *
+ * The copy gets the original's permissions (so restored executables
+ * stay executable) but a fresh modification time.
+ */
+
+static int
+cache_copy(
+	const char *from,
+	const char *to )
+{
+	char	tmp[ MAXJPATH + 16 ];
+	char	buf[ 8192 ];
+	struct stat sb;
+	FILE	*f, *t;
+	int	n, err = 0;
+
+	if( !*from || !*to || strlen( to ) + 12 > sizeof( tmp ) || 
+	    stat( from, &sb ) )
+	    return -1;
+
+	sprintf( tmp, "%s.%d", to, (int)getpid() );
+
+	if( !( f = fopen( from, "rb" ) ) )
+	    return -1;
+
+	if( !( t = fopen( tmp, "wb" ) ) )
+	{
+	    fclose( f );
+	    return -1;
+	}
+
+	while( ( n = fread( buf, 1, sizeof( buf ), f ) ) > 0 )
+	    if( fwrite( buf, 1, n, t ) != n )
+		err = -1;
+
+	if( ferror( f ) )
+	    err = -1;
+
+	fclose( f );
+
+	if( fclose( t ) )
+	    err = -1;
+
+	if( !err )
+	    chmod( tmp, sb.st_mode & 0777 );
+
+# ifdef OS_NT
+	if( !err )
+	    unlink( to );
+# endif
+
+	if( err || rename( tmp, to ) )
+	{
+	    unlink( tmp );
+	    return -1;
+	}
+
+	return 0;
+}
+
+# else
+
+CACHEKEY *cache_key( TARGET *t, CMD *cmds ) { return 0; }
+int cache_fetch( CACHEKEY *k ) { return 0; }
+void cache_store( CACHEKEY *k ) {}
+void cache_free( CACHEKEY *k ) {}
+
+# endif /* USE_CACHE */
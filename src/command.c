@@ -7,6 +7,20 @@
 /*
  * command.c - maintain lists of commands
  *
+ * For 'actions response', $(>) is replaced by the single word @file
+ * (or rather $(JAMRSP)file, if JAMRSP is set), where file is the first
+ * target's name with .rsp appended.  Cmd_rsp() writes the sources to
+ * the file, one per line, just before the command is run, and 
+ * cmd_free() removes it afterwards.  So however many sources there 
+ * are, the action runs as one command: no PIECEMEAL splitting.
+ *
+ * Commands are expanded into a scratch buffer shared by all CMDs and
+ * then copied into one of just the right size, since make1cmds() may
+ * build thousands of them before any are run.  Likewise only $(<) is
+ * kept with the CMD, for messages: $(>) is done with once expanded,
+ * unless there are $(JAMWORKERS), which need to know a command's
+ * inputs (for 'actions response', the sources and the file).
+ *
  * 01/20/00 (seiwald) - Upgraded from K&R to ANSI C
  * 09/08/00 (seiwald) - bulletproof PIECEMEAL size computation
  */
@@ -19,6 +33,11 @@
 # include "rules.h"
 
 # include "command.h"
+# include "remote.h"
+
+# ifdef unix
+# include <unistd.h>
+# endif
 
 /*
  * cmd_new() - return a new CMD or 0 if too many args
@@ -32,26 +51,76 @@ cmd_new(
 	LIST	*shell,
 	int	maxline )
 {
+	static char *scratch = 0;
+	static int scratchsize = 0;
+
 	CMD *cmd = (CMD *)malloc( sizeof( CMD ) );
+	LOL args;
+	int len;
 
 	cmd->rule = rule;
 	cmd->shell = shell;
 	cmd->next = 0;
-	cmd->buf = (char *)malloc( maxline );
+	cmd->buf = 0;
+	cmd->start = 0;
+	cmd->rss = 0;
+	cmd->rsp = 0;
+	cmd->rspfile = 0;
+
+	/* For 'actions response', swap $(>) for @file. */
+
+	if( ( rule->flags & RULE_RESPONSE ) && sources && targets )
+	{
+	    LIST *prefix = var_get( "JAMRSP" );
+	    const char *p = prefix ? prefix->string : "@";
+	    char *word;
+
+	    cmd->rsp = sources;
+	    cmd->rspfile = (char *)malloc( strlen( targets->string ) + 5 );
+	    sprintf( cmd->rspfile, "%s.rsp", targets->string );
+
+	    word = (char *)malloc( strlen( p ) + strlen( cmd->rspfile ) + 1 );
+	    sprintf( word, "%s%s", p, cmd->rspfile );
+	    sources = list_new( L0, word, 0 );
+	    free( word );
+	}
 
 	lol_init( &cmd->args );
 	lol_add( &cmd->args, targets );
-	lol_add( &cmd->args, sources );
+
+	if( remote_init() )
+	    lol_add( &cmd->args, !cmd->rsp ? list_copy( L0, sources ) :
+		list_new( list_copy( L0, cmd->rsp ), cmd->rspfile, 0 ) );
+
+	lol_init( &args );
+	lol_add( &args, targets );
+	lol_add( &args, sources );
+
+	/* Grow the scratch buffer to the largest maxline yet. */
+
+	if( maxline > scratchsize )
+	{
+	    free( scratch );
+	    scratch = (char *)malloc( maxline );
+	    scratchsize = maxline;
+	}
 
 	/* Bail if the result won't fit in maxline */
-	/* We don't free targets/sources/shell if bailing. */
+	/* Targets/sources/shell are freed either way. */
+
+	len = var_string( rule->actions, scratch, maxline, &args );
 
-	if( var_string( rule->actions, cmd->buf, maxline, &cmd->args ) < 0 )
+	list_free( sources );
+
+	if( len < 0 )
 	{
 	    cmd_free( cmd );
 	    return 0;
 	}
 
+	cmd->buf = (char *)malloc( len );
+	memcpy( cmd->buf, scratch, len );
+
 	return cmd;
 }
 
@@ -62,8 +131,68 @@ cmd_new(
 void
 cmd_free( CMD *cmd )
 {
+	/* Under -o, leave response files for the commands written out */
+
+	if( cmd->rspfile && !globs.cmdout )
+	    unlink( cmd->rspfile );
+
+	free( cmd->rspfile );
+	list_free( cmd->rsp );
 	lol_free( &cmd->args );
 	list_free( cmd->shell );
 	free( (char *)cmd->buf );
 	free( (char *)cmd );
 }
+
+/*
+ * cmd_rsp() - write the response file for 'actions response'
+ *
+ * Words with white space or quotes in them are put in double quotes.
+ * Returns -1 (having said so) if the file can't be written.
+ */
+
+int
+cmd_rsp( CMD *cmd )
+{
+	FILE	*f;
+	LIST	*l;
+
+	if( !cmd->rspfile )
+	    return 0;
+
+	if( !( f = fopen( cmd->rspfile, "w" ) ) )
+	{
+	    printf( "can't write response file %s\n", cmd->rspfile );
+	    return -1;
+	}
+
+	for( l = cmd->rsp; l; l = list_next( l ) )
+	{
+	    const char *s = l->string;
+
+	    if( !s[ strcspn( s, " \t\"'" ) ] )
+	    {
+		fprintf( f, "%s\n", s );
+		continue;
+	    }
+
+	    fputc( '"', f );
+
+	    for( ; *s; s++ )
+	    {
+		if( *s == '"' || *s == '\\' )
+		    fputc( '\\', f );
+		fputc( *s, f );
+	    }
+
+	    fputs( "\"\n", f );
+	}
+
+	if( fclose( f ) )
+	{
+	    printf( "can't write response file %s\n", cmd->rspfile );
+	    return -1;
+	}
+
+	return 0;
+}
@@ -52,6 +52,56 @@ execmax()
 	return MAXLINE;
 }
 
+/*
+ * execcpus() - number of CPUs this process may actually use
+ */
+
+int
+execcpus()
+{
+	return 1;
+}
+
+/*
+ * execload() - is the system too busy to start another command?
+ */
+
+int
+execload()
+{
+	return 0;
+}
+
+/*
+ * execrss() - peak memory of the command whose completion is driven
+ */
+
+long
+execrss()
+{
+	return 0;
+}
+
+/*
+ * execpoll() - drive one execution completion, if any has finished
+ */
+
+int
+execpoll()
+{
+	return 0;
+}
+
+/*
+ * execready() - can a command be launched without waiting?
+ */
+
+int
+execready()
+{
+	return 1;
+}
+
 /*
  * execcmd() - launch an async command execution
  */
@@ -61,7 +111,8 @@ execcmd(
 	char *string,
 	void (*func)( void *closure, int status ),
 	void *closure,
-	LIST *shell )
+	LIST *shell,
+	LOL *args )
 {
 	
 	printf( "%s", string );
@@ -25,9 +25,68 @@
  * External routines:
  *	execcmd() - launch an async command execution
  * 	execwait() - wait and drive at most one execution completion
+ *	execpoll() - drive one execution completion, if any has finished
+ *	execready() - can a command be launched without waiting?
+ *	execexit() - exit code of the command whose completion is driven
+ *	execrss() - peak memory of the command whose completion is driven
+ *	execmax() - max permitted string to execcmd()
+ *	execcpus() - number of CPUs this process may actually use
+ *	execload() - is the system too busy to start another command?
  *
  * Internal routines:
  *	onintr() - bump intr to note command interruption
+ *	execreap() - collect one or more finished children
+ *	execdrive() - drive the oldest completion execreap() collected
+ *	execwatch() - register a new child's pidfd with the epoll set
+ *	execslots() - size cmdtab to fit globs.jobs
+ *	execdirect() - spawn a command that needs no shell directly
+ *	execpool() - hand a command to the slot's pooled shell
+ *	execpoolstart() - start a pooled shell for a slot
+ *	execpoolwrite() - write to a pooled shell, surviving its death
+ *	execpooldone() - pick up the exit status from a pooled shell
+ *	execpoolstop() - close down a slot's pooled shell
+ *	execremote() - hand a command to the slot's jamworker
+ *	execremotedone() - pick up a command's results from its jamworker
+ *
+ * On Linux each child gets a pidfd registered with an epoll set, so
+ * that execreap() can pick up many completions per wakeup and find
+ * their cmdtab slots directly.  Elsewhere (or if pidfds are refused)
+ * execreap() falls back to wait() followed by non-blocking waitpid()s.
+ * Completions collected by execreap() are queued and then driven one
+ * at a time by execwait(), so make1()'s callbacks see no difference.
+ *
+ * Also on Linux, if $(JAMSHELLPOOL) is set, each slot keeps a /bin/sh
+ * running, reading a script from a pipe on its fd 8.  Rather than
+ * starting /bin/sh -c for each command, execcmd() writes the command
+ * to the slot's shell as
+ *
+ *	( eval '...' ) 8<&- 9>&-
+ *	echo $? >&9
+ *
+ * and the exit status comes back on another pipe (the shell's fd 9),
+ * which is watched in the same epoll set as the pidfds.  The subshell
+ * keeps each command from changing the pooled shell's state, and the
+ * eval keeps a command with unbalanced quotes from swallowing the next.
+ * Commands for $(JAMSHELL) are always run the usual way.
+ *
+ * Also on Linux, if $(JAMWORKERS) is set, execcmd() sends commands to
+ * jamworker daemons (see remote.c) and watches each slot's connection
+ * in the epoll set for the response.  Commands without targets and
+ * sources to send (batches), and those for $(JAMSHELL), run here.
+ *
+ * Where there's posix_spawn(), a command that is a single line with
+ * nothing in it the shell would interpret (just words separated by
+ * blanks, the first neither a shell builtin nor a VAR=value) is split
+ * into words and run directly, sparing a /bin/sh per compile.  If the
+ * program can't be spawned, the command goes to the shell after all,
+ * so as to fail as it always has.
+ *
+ * The shell (or $(JAMSHELL)) is likewise started with posix_spawnp()
+ * where there is one, rather than by vfork() or fork() of what can
+ * be a large jam process: the C library can then use the cheapest way
+ * the system has (e.g. clone() with CLONE_VM|CLONE_VFORK on Linux, 
+ * which doesn't copy page tables and holds up only the calling thread).
+ * Vfork() remains the fallback.
  *
  * 04/08/94 (seiwald) - Coherent/386 support added.
  * 05/04/94 (seiwald) - async multiprocess interface
@@ -42,6 +101,7 @@
 # include "jam.h"
 # include "lists.h"
 # include "execcmd.h"
+# include "jobserver.h"
 # include <errno.h>
 
 # ifdef USE_EXECUNIX
@@ -55,6 +115,21 @@
 # include <unistd.h>
 # endif
 
+# if defined( OS_LINUX )
+# include <unistd.h>
+# include <sys/syscall.h>
+# include <sys/epoll.h>
+# ifdef SYS_pidfd_open
+# define USE_PIDFD
+# define USE_SHPOOL
+# include <fcntl.h>
+# include <signal.h>
+# include "variable.h"
+# include "remote.h"
+# define USE_REMOTE
+# endif
+# endif
+
 # ifdef OS_NT 
 # define USE_EXECNT
 # include <process.h>
@@ -67,21 +142,111 @@ static int my_wait( int *status );
 # endif
 # endif
 
+# ifndef USE_EXECNT
+# include <unistd.h>
+# include <sys/wait.h>
+# endif
+
+/* wait4() also tells how much memory the child used at its peak. */
+
+# ifdef unix
+# include <sys/resource.h>
+static struct rusage ru;	/* of the child last waited for */
+# define wait( s )		wait4( -1, s, 0, &ru )
+# define waitpid( p, s, o )	wait4( p, s, o, &ru )
+# ifdef OS_MACOSX
+# define MAXRSS		( ru.ru_maxrss / 1024 )	/* in bytes there */
+# else
+# define MAXRSS		( ru.ru_maxrss )
+# endif
+# else
+# define MAXRSS		0
+# endif
+
+# if defined( OS_LINUX ) || defined( OS_MACOSX ) || \
+     defined( OS_FREEBSD ) || defined( OS_NETBSD ) || \
+     defined( OS_OPENBSD ) || defined( OS_SOLARIS )
+# define USE_SPAWN
+# include <spawn.h>
+extern char **environ;
+# endif
+
 static int intr = 0;
 static int cmdsrunning = 0;
+static int lastexit = 0;	/* for execexit() */
+static long lastrss = 0;	/* for execrss() */
 static void (*istat)( int );
 
-static struct
+static struct _cmdtab
 {
 	int	pid; /* on win32, a real process handle */
 	void	(*func)( void *closure, int status );
 	void 	*closure;
+	int	status;		/* wait() status, once reaped */
+	long	rss;		/* peak KB, once reaped, if known */
+
+# ifdef USE_PIDFD
+	int	pidfd;		/* registered with epollfd, or -1 */
+# endif
+
+# ifdef USE_SHPOOL
+	int	wpid;		/* pooled shell, or 0 */
+	int	wcmd;		/* pipe to its fd 8 (script) */
+	int	wstat;		/* pipe from its fd 9 (status) */
+	int	pooled;		/* command running is in wpid */
+# endif
+
+# ifdef USE_REMOTE
+	int	remote;		/* command running is on a jamworker */
+	int	rfd;		/* connection to it, in epollfd */
+# endif
 
 # ifdef USE_EXECNT
 	char	*tempfile;
 # endif
 
-} cmdtab[ MAXJOBS ] = {{0}};
+} *cmdtab = 0;
+
+static int maxjobs = 0;		/* slots in cmdtab, from globs.jobs */
+
+/* Slots reaped by execreap() but not yet driven by execwait() */
+
+static int *reaped = 0;
+static int nreaped = 0;
+
+static void execreap( int nohang );
+static int execdrive();
+static void execslots();
+
+# ifdef USE_SPAWN
+static int execdirect( const char *string );
+# endif
+
+# ifdef USE_PIDFD
+static int epollfd = -1;	/* epoll set of running children's pidfds */
+static int nopidfd = 0;		/* children running without a pidfd */
+static void execwatch( int slot );
+static void execepoll();
+# define JOBTOKEN 0x40000	/* epoll data: the jobserver's read end */
+# endif
+
+# ifdef USE_SHPOOL
+# define POOLED	0x10000		/* epoll data: a pooled shell's status */
+static int npooled = 0;		/* commands running in pooled shells */
+static int execpool( int slot, const char *string );
+static int execpoolstart( int slot );
+static int execpoolwrite( int fd, const char *buf, int len );
+static void execpooldone( int slot );
+static void execpoolstop( int slot );
+# endif
+
+# ifdef USE_REMOTE
+# define REMOTE	0x20000		/* epoll data: a jamworker's response */
+# define REMOTEPID -2		/* cmdtab pid of a command on a jamworker */
+static int nremote = 0;		/* commands running on jamworkers */
+static int execremote( int slot, const char *string, LOL *args );
+static void execremotedone( int slot );
+# endif
 
 /*
  * onintr() - bump intr to note command interruption
@@ -150,6 +315,211 @@ execmax()
 
 # endif
 
+/*
+ * execcpus() - number of CPUs this process may actually use
+ *
+ * For -j auto.  On Linux, that's the CPUs in our affinity mask, further
+ * trimmed by any cgroup CPU quota (cpu.max, or cfs_quota_us on cgroup
+ * v1) so that containers don't run a job per host CPU.
+ */
+
+# ifdef OS_LINUX
+
+static int
+execquota( const char *file, const char *file2 )
+{
+	FILE *f;
+	char buf[ 64 ];
+	long quota = -1, period = 0;
+
+	/* cgroup v2 cpu.max is "quota period" or "max period"; */
+	/* cgroup v1 splits them into cpu.cfs_quota_us/period_us. */
+
+	if( !( f = fopen( file, "r" ) ) )
+	    return 0;
+
+	if( fgets( buf, sizeof( buf ), f ) )
+	    sscanf( buf, "%ld %ld", &quota, &period );
+
+	fclose( f );
+
+	if( file2 && ( f = fopen( file2, "r" ) ) )
+	{
+	    if( fgets( buf, sizeof( buf ), f ) )
+		period = atol( buf );
+	    fclose( f );
+	}
+
+	if( quota <= 0 || period <= 0 )
+	    return 0;
+
+	return ( quota + period - 1 ) / period;
+}
+
+int
+execcpus()
+{
+	unsigned long mask[ 1024 ];
+	char path[ MAXJPATH ], buf[ MAXJPATH ];
+	int cpus = 0;
+	int n, i;
+	FILE *f;
+
+	/* CPUs we may be scheduled on. */
+
+	n = syscall( SYS_sched_getaffinity, 0, sizeof( mask ), mask );
+
+	for( i = 0; i < n * 8; i++ )
+	    if( mask[ i / ( 8 * sizeof( *mask ) ) ] & 
+		( 1UL << i % ( 8 * sizeof( *mask ) ) ) )
+		    cpus++;
+
+	if( cpus <= 0 )
+	    cpus = sysconf( _SC_NPROCESSORS_ONLN );
+
+	/* cgroup v2: our group is "0::/path"; any cpu.max up the */
+	/* hierarchy can hold us down. */
+
+	if( ( f = fopen( "/proc/self/cgroup", "r" ) ) )
+	{
+	    while( fgets( buf, sizeof( buf ), f ) )
+	    {
+		char *p;
+
+		if( strncmp( buf, "0::/", 4 ) )
+		    continue;
+
+		p = buf + 3 + strcspn( buf + 3, "\n" );
+		*p = 0;
+
+		while( p > buf + 3 )
+		{
+		    int q;
+
+		    sprintf( path, "/sys/fs/cgroup%.*s/cpu.max", 
+			(int)( p - buf - 3 ), buf + 3 );
+
+		    if( ( q = execquota( path, 0 ) ) && q < cpus )
+			cpus = q;
+
+		    while( *--p != '/' )
+			;
+		}
+	    }
+
+	    fclose( f );
+	}
+
+	/* The top of the cgroup namespace, v2 or v1. */
+
+	if( ( i = execquota( "/sys/fs/cgroup/cpu.max", 0 ) ) && i < cpus )
+	    cpus = i;
+
+	if( ( i = execquota( "/sys/fs/cgroup/cpu/cpu.cfs_quota_us",
+			     "/sys/fs/cgroup/cpu/cpu.cfs_period_us" ) ) && 
+	    i < cpus )
+	    cpus = i;
+
+	if( DEBUG_EXECCMD )
+	    printf( "execcpus: %d\n", cpus );
+
+	return cpus > 0 ? cpus : 1;
+}
+
+# else
+
+int
+execcpus()
+{
+# if defined( OS_NT )
+	SYSTEM_INFO si;
+
+	GetSystemInfo( &si );
+
+	return si.dwNumberOfProcessors;
+# elif defined( _SC_NPROCESSORS_ONLN )
+	int cpus = sysconf( _SC_NPROCESSORS_ONLN );
+
+	return cpus > 0 ? cpus : 1;
+# else
+	return 1;
+# endif
+}
+
+# endif
+
+/*
+ * execload() - is the system too busy to start another command?
+ *
+ * For -l and -p.  On Linux, "load" is the number of processes ready
+ * to run right now (from /proc/loadavg, less ourselves), as the load
+ * averages lag far behind the commands we start; pressure is the
+ * 10 second average of the share of time some tasks stalled waiting
+ * for CPU or memory (/proc/pressure).  Elsewhere, load is the 1 minute
+ * load average, and there's no pressure.
+ */
+
+# ifdef OS_LINUX
+
+static double
+execpressure( const char *file )
+{
+	FILE *f;
+	double avg = 0.0;
+
+	if( ( f = fopen( file, "r" ) ) )
+	{
+	    if( fscanf( f, "some avg10=%lf", &avg ) != 1 )
+		avg = 0.0;
+	    fclose( f );
+	}
+
+	return avg;
+}
+
+# endif
+
+int
+execload()
+{
+# ifdef OS_LINUX
+	if( globs.maxload > 0 )
+	{
+	    FILE *f;
+	    double avg[3];
+	    int running = 0;
+
+	    if( ( f = fopen( "/proc/loadavg", "r" ) ) )
+	    {
+		if( fscanf( f, "%lf %lf %lf %d", 
+			&avg[0], &avg[1], &avg[2], &running ) != 4 )
+		    running = 0;
+		fclose( f );
+	    }
+
+	    if( running - 1 > globs.maxload )
+		return 1;
+	}
+
+	if( globs.maxpressure > 0 &&
+	    ( execpressure( "/proc/pressure/cpu" ) > globs.maxpressure ||
+	      execpressure( "/proc/pressure/memory" ) > globs.maxpressure ) )
+		return 1;
+
+# else
+# if defined( OS_MACOSX ) || defined( OS_FREEBSD ) || \
+     defined( OS_NETBSD ) || defined( OS_OPENBSD )
+	double avg;
+
+	if( globs.maxload > 0 && getloadavg( &avg, 1 ) == 1 && 
+	    avg > globs.maxload )
+		return 1;
+# endif
+# endif
+
+	return 0;
+}
+
 /*
  * execcmd() - launch an async command execution
  */
@@ -159,7 +529,8 @@ execcmd(
 	char *string,
 	void (*func)( void *closure, int status ),
 	void *closure,
-	LIST *shell )
+	LIST *shell,
+	LOL *args )
 {
 	int pid;
 	int slot;
@@ -169,13 +540,29 @@ execcmd(
 	char *p;
 # endif
 
+	/* Wait until we're under the limit of concurrent commands. */
+	/* Don't trust globs.jobs alone. */
+
+	while( cmdsrunning >= globs.jobs || ( cmdtab && cmdsrunning >= maxjobs ) )
+	    if( !execwait() )
+		break;
+
+	/* Under a jobserver, each command beyond the first needs a token. */
+
+	while( !jobserver_take( cmdsrunning ) )
+	    if( !execwait() )
+		break;
+
 	/* Find a slot in the running commands table for this one. */
 
-	for( slot = 0; slot < MAXJOBS; slot++ )
+	if( !cmdtab )
+	    execslots();
+
+	for( slot = 0; slot < maxjobs; slot++ )
 	    if( !cmdtab[ slot ].pid )
 		break;
 
-	if( slot == MAXJOBS )
+	if( slot == maxjobs )
 	{
 	    printf( "no slots for child!\n" );
 	    exit( EXITBAD );
@@ -234,7 +621,7 @@ execcmd(
 	if( shell )
 	{
 	    int i;
-	    char jobno[4];
+	    char jobno[12];
 	    int gotpercent = 0;
 
 	    sprintf( jobno, "%d", slot + 1 );
@@ -283,10 +670,28 @@ execcmd(
 	    exit( EXITBAD );
 	}
 # else
+	pid = 0;
+
+# ifdef USE_REMOTE
+	if( !shell && args && execremote( slot, string, args ) )
+	    pid = REMOTEPID;
+# endif
+# ifdef USE_SPAWN
+	if( !pid && !shell )
+	    pid = execdirect( string );
+# endif
+# ifdef USE_SHPOOL
+	if( !pid && !shell && execpool( slot, string ) )
+	    pid = cmdtab[ slot ].wpid;
+# endif
+# ifdef USE_SPAWN
+	if( !pid && posix_spawnp( &pid, argv[0], 0, 0, (char **)argv, environ ) )
+	    pid = 0;
+# endif
 # ifdef NO_VFORK
-	if ((pid = fork()) == 0) 
+	if( !pid && ( pid = fork() ) == 0 )
 # else
-	if ((pid = vfork()) == 0) 
+	if( !pid && ( pid = vfork() ) == 0 )
 # endif
    	{
 	    /* hpux doesn't like const here */
@@ -305,53 +710,99 @@ execcmd(
 	cmdtab[ slot ].func = func;
 	cmdtab[ slot ].closure = closure;
 
-	/* Wait until we're under the limit of concurrent commands. */
-	/* Don't trust globs.jobs alone. */
-
-	while( cmdsrunning >= MAXJOBS || cmdsrunning >= globs.jobs )
-	    if( !execwait() )
-		break;
+# ifdef USE_PIDFD
+	if( !cmdtab[ slot ].pooled && !cmdtab[ slot ].remote )
+	    execwatch( slot );
+# endif
 }
 
 /*
  * execwait() - wait and drive at most one execution completion
+ *
+ * Under a jobserver, with a slot free but no token for it, returns
+ * having driven nothing if a token comes before any completion.
  */
 
 int
 execwait()
 {
-	int i;
-	int status, w;
-	int rstat;
-
 	/* Handle naive make1() which doesn't know if cmds are running. */
 
 	if( !cmdsrunning )
 	    return 0;
 
-	/* Pick up process pid and status */
-    
-	while( ( w = wait( &status ) ) == -1 && errno == EINTR )
-		;
+	/* Pick up finished children, unless some are already queued. */
 
-	if( w == -1 )
-	{
-	    printf( "child process(es) lost!\n" );
-	    perror("wait");
-	    exit( EXITBAD );
-	}
+	if( !nreaped )
+	    execreap( 0 );
 
-	/* Find the process in the cmdtab. */
+	/* A jobserver token may have come first: nothing to drive. */
 
-	for( i = 0; i < MAXJOBS; i++ )
-	    if( w == cmdtab[ i ].pid )
-		break;
+	if( !nreaped )
+	    return 1;
 
-	if( i == MAXJOBS )
-	{
-	    printf( "waif child found!\n" );
-	    exit( EXITBAD );
-	}
+	return execdrive();
+}
+
+/*
+ * execpoll() - drive one execution completion, if any has finished
+ *
+ * Like execwait(), but returns 0 rather than wait for a command.
+ */
+
+int
+execpoll()
+{
+	if( !cmdsrunning )
+	    return 0;
+
+# ifdef USE_EXECNT
+	if( !nreaped )
+	    return 0;
+# else
+	if( !nreaped )
+	    execreap( 1 );
+
+	if( !nreaped )
+	    return 0;
+# endif
+
+	return execdrive();
+}
+
+/*
+ * execready() - can a command be launched without waiting?
+ *
+ * Execcmd() waits for a slot to come free if there is none; this says
+ * whether there is one now.  Under a jobserver, it also takes the token
+ * the command will need, if one can be read without waiting, so that
+ * execcmd() won't wait for one either.
+ */
+
+int
+execready()
+{
+	return cmdsrunning < globs.jobs && ( !cmdtab || cmdsrunning < maxjobs ) &&
+	    jobserver_take( cmdsrunning );
+}
+
+/*
+ * execdrive() - drive the oldest completion execreap() collected
+ */
+
+static int
+execdrive()
+{
+	int i;
+	int rstat;
+
+	/* Take the oldest completion off the queue. */
+
+	i = reaped[ 0 ];
+
+	if( --nreaped )
+	    memmove( (char *)reaped, (char *)( reaped + 1 ), 
+		nreaped * sizeof( *reaped ) );
 
 # ifdef USE_EXECNT
 	/* Clear the temp file */
@@ -364,20 +815,770 @@ execwait()
 	if( !--cmdsrunning )
 	    signal( SIGINT, istat );
 
+	jobserver_give( cmdsrunning );
+
 	if( intr )
 	    rstat = EXEC_CMD_INTR;
-	else if( w == -1 || status != 0 )
+	else if( cmdtab[ i ].status != 0 )
 	    rstat = EXEC_CMD_FAIL;
 	else
 	    rstat = EXEC_CMD_OK;
 
+# ifdef USE_EXECNT
+	lastexit = cmdtab[ i ].status;
+# else
+	lastexit = WIFEXITED( cmdtab[ i ].status ) ? 
+			WEXITSTATUS( cmdtab[ i ].status ) : -1;
+# endif
+
+	lastrss = cmdtab[ i ].rss;
+
 	cmdtab[ i ].pid = 0;
 
+# ifdef USE_SHPOOL
+	if( cmdtab[ i ].pooled )
+	    cmdtab[ i ].pooled = 0, npooled--;
+# endif
+
+# ifdef USE_REMOTE
+	if( cmdtab[ i ].remote )
+	    cmdtab[ i ].remote = 0, nremote--;
+# endif
+
 	(*cmdtab[ i ].func)( cmdtab[ i ].closure, rstat );
 
+	lastrss = 0;
+
 	return 1;
 }
 
+/*
+ * execexit() - exit code of the command whose completion is driven
+ *
+ * Only meaningful from within the completion function execwait()
+ * calls; -1 if the command didn't exit normally (e.g. was killed).
+ */
+
+int
+execexit()
+{
+	return lastexit;
+}
+
+/*
+ * execrss() - peak memory of the command whose completion is driven
+ *
+ * In KB; 0 if unknown, or called from outside the completion function.
+ */
+
+long
+execrss()
+{
+	return lastrss;
+}
+
+/*
+ * execreap() - collect one or more finished children
+ *
+ * Blocks until at least one running child has exited (unless nohang),
+ * then queues every child found finished onto reaped[] for execdrive().
+ * With the epoll set, also returns once it takes a jobserver token
+ * that execcmd() is short of.
+ */
+
+static void
+execreap( int nohang )
+{
+	int i;
+	int status, w;
+
+# ifdef USE_PIDFD
+	int jsfd = -1;
+	int token = 0;
+
+	/* With a slot free but no jobserver token to fill it, wait for */
+	/* a token as well as for the children. */
+
+	if( epollfd >= 0 && !nohang && 
+	    cmdsrunning < globs.jobs && cmdsrunning < maxjobs &&
+	    ( jsfd = jobserver_want( cmdsrunning ) ) >= 0 )
+	{
+	    struct epoll_event ev;
+
+	    memset( (char *)&ev, '\0', sizeof( ev ) );
+	    ev.events = EPOLLIN;
+	    ev.data.u32 = JOBTOKEN;
+
+	    if( epoll_ctl( epollfd, EPOLL_CTL_ADD, jsfd, &ev ) < 0 )
+		jsfd = -1;
+	}
+
+	/* All children watched by pidfds: epoll tells us the slots. */
+	/* Pooled shells' status pipes and jamworker connections are in */
+	/* the epoll set too, so if some children have no pidfd, we have */
+	/* to poll for those. */
+
+	if( epollfd >= 0 && ( !nopidfd || npooled || nremote || jsfd >= 0 ) )
+	  while( !nreaped && !token )
+	{
+	    static struct epoll_event *ev = 0;
+	    int n, e;
+
+	    if( !ev )
+		ev = (struct epoll_event *)malloc( maxjobs * sizeof( *ev ) );
+
+	    while( ( n = epoll_wait( epollfd, ev, maxjobs, 
+			nohang ? 0 : nopidfd ? 100 : -1 ) ) == -1 && 
+			errno == EINTR )
+		;
+
+	    if( n == -1 )
+	    {
+		printf( "child process(es) lost!\n" );
+		perror( "epoll_wait" );
+		exit( EXITBAD );
+	    }
+
+	    for( e = 0; e < n; e++ )
+	    {
+		i = ev[ e ].data.u32;
+
+		if( i & JOBTOKEN )
+		{
+		    token = jobserver_take( cmdsrunning );
+		    continue;
+		}
+
+		if( i & POOLED )
+		{
+		    execpooldone( i & ~POOLED );
+		    continue;
+		}
+
+		if( i & REMOTE )
+		{
+		    execremotedone( i & ~REMOTE );
+		    continue;
+		}
+
+		while( ( w = waitpid( cmdtab[ i ].pid, &status, 0 ) ) == -1 &&
+			errno == EINTR )
+		    ;
+
+		if( w == -1 )
+		{
+		    printf( "child process(es) lost!\n" );
+		    perror( "waitpid" );
+		    exit( EXITBAD );
+		}
+
+		close( cmdtab[ i ].pidfd );
+		cmdtab[ i ].pidfd = -1;
+		cmdtab[ i ].pid = -1;
+		cmdtab[ i ].status = status;
+		cmdtab[ i ].rss = MAXRSS;
+		reaped[ nreaped++ ] = i;
+	    }
+
+	    /* Sweep up children without pidfds (or any others). */
+	    /* Pooled shells that die are dealt with by execpooldone(). */
+
+	    while( nopidfd && ( w = waitpid( -1, &status, WNOHANG ) ) > 0 )
+	    {
+		for( i = 0; i < maxjobs; i++ )
+		    if( w == cmdtab[ i ].pid && !cmdtab[ i ].pooled )
+			break;
+
+		if( i == maxjobs )
+		    continue;
+
+		if( cmdtab[ i ].pidfd >= 0 )
+		    close( cmdtab[ i ].pidfd );
+		else
+		    nopidfd--;
+
+		cmdtab[ i ].pidfd = -1;
+		cmdtab[ i ].pid = -1;
+		cmdtab[ i ].status = status;
+		cmdtab[ i ].rss = MAXRSS;
+		reaped[ nreaped++ ] = i;
+	    }
+
+	    if( nohang )
+		return;
+	}
+
+	if( jsfd >= 0 )
+	    epoll_ctl( epollfd, EPOLL_CTL_DEL, jsfd, (struct epoll_event *)0 );
+
+	if( nreaped || token )
+	    return;
+# endif
+
+	/* Pick up process pid and status */
+    
+# ifndef USE_EXECNT
+	if( nohang )
+	    w = waitpid( -1, &status, WNOHANG );
+	else
+# endif
+	while( ( w = wait( &status ) ) == -1 && errno == EINTR )
+		;
+
+	while( w != 0 )
+	{
+	    if( w == -1 )
+	    {
+		/* Lost children are only fatal if none were found. */
+
+		if( nreaped )
+		    break;
+
+		printf( "child process(es) lost!\n" );
+		perror("wait");
+		exit( EXITBAD );
+	    }
+
+	    /* Find the process in the cmdtab. */
+
+	    for( i = 0; i < maxjobs; i++ )
+		if( w == cmdtab[ i ].pid )
+		    break;
+
+	    if( i == maxjobs )
+	    {
+		printf( "waif child found!\n" );
+		exit( EXITBAD );
+	    }
+
+# ifdef USE_PIDFD
+	    if( cmdtab[ i ].pidfd >= 0 )
+		close( cmdtab[ i ].pidfd );
+	    else
+		nopidfd--;
+
+	    cmdtab[ i ].pidfd = -1;
+# endif
+
+	    /* Hold the slot (pid -1) until execwait() drives it. */
+
+	    cmdtab[ i ].pid = -1;
+	    cmdtab[ i ].status = status;
+	    cmdtab[ i ].rss = MAXRSS;
+	    reaped[ nreaped++ ] = i;
+
+	    /* Sweep up any others that finished meanwhile. */
+
+# ifdef USE_EXECNT
+	    break;
+# else
+	    if( nreaped == cmdsrunning )
+		break;
+
+	    while( ( w = waitpid( -1, &status, WNOHANG ) ) == -1 && 
+		    errno == EINTR )
+		;
+# endif
+	}
+}
+
+# ifdef USE_SPAWN
+
+/*
+ * execdirect() - spawn a command that needs no shell directly
+ *
+ * Returns the child's pid, or 0 if the command needs the shell.
+ */
+
+static int
+execdirect( const char *string )
+{
+	/* Words that mean something else to the shell. */
+
+	static const char *builtins[] = {
+		".", ":", "alias", "bg", "break", "case", "cd", "command",
+		"continue", "do", "done", "elif", "else", "esac", "eval",
+		"exec", "exit", "export", "fc", "fg", "fi", "for", "getopts",
+		"hash", "if", "jobs", "local", "read", "readonly", "return",
+		"set", "shift", "then", "times", "trap", "type", "ulimit",
+		"umask", "unalias", "unset", "until", "wait", "while", 0
+	} ;
+
+	const char *s, *e;
+	char *buf, *p;
+	char **argv;
+	int argc, i, pid;
+
+	/* Trim white space; what's left must be one line of words */
+	/* with no quoting, expansions, redirections, etc. */
+
+	for( s = string; isspace( *s ); s++ )
+	    ;
+
+	for( e = s + strlen( s ); e > s && isspace( e[-1] ); e-- )
+	    ;
+
+	if( s == e || 
+	    s + strcspn( s, "\n\r|&;<>()$`\\\"'*?[]#~{}!" ) < e )
+		return 0;
+
+	/* Split into argv. */
+
+	buf = malloc( e - s + 1 );
+	memcpy( buf, s, e - s );
+	buf[ e - s ] = 0;
+
+	for( argc = 1, p = buf; *p; p++ )
+	    if( isspace( *p ) && !isspace( p[1] ) )
+		argc++;
+
+	argv = (char **)malloc( ( argc + 1 ) * sizeof( char * ) );
+
+	for( argc = 0, p = buf; *p; )
+	{
+	    argv[ argc++ ] = p;
+
+	    while( *p && !isspace( *p ) )
+		p++;
+
+	    while( isspace( *p ) )
+		*p++ = 0;
+	}
+
+	argv[ argc ] = 0;
+
+	for( i = 0; builtins[i]; i++ )
+	    if( !strcmp( argv[0], builtins[i] ) )
+		break;
+
+	/* An = only matters in the first word: VAR=value assigns. */
+
+	if( builtins[i] || strchr( argv[0], '=' ) ||
+	    posix_spawnp( &pid, argv[0], 0, 0, argv, environ ) )
+	    pid = 0;
+
+	if( pid && DEBUG_EXECCMD )
+	    printf( "spawned %s directly\n", argv[0] );
+
+	free( (char *)argv );
+	free( buf );
+
+	return pid;
+}
+
+# endif /* USE_SPAWN */
+
+/*
+ * execslots() - size cmdtab to fit globs.jobs
+ *
+ * There's no compile-time cap: cmdtab is allocated on first use, once
+ * -j is known, with room for every job we're allowed to run.
+ */
+
+static void
+execslots()
+{
+	maxjobs = globs.jobs > 0 ? globs.jobs : 1;
+
+# ifdef USE_MYWAIT
+	/* WaitForMultipleObjects() can't watch any more than this. */
+
+	if( maxjobs > MAXIMUM_WAIT_OBJECTS )
+	    maxjobs = MAXIMUM_WAIT_OBJECTS;
+# endif
+
+	cmdtab = (struct _cmdtab *)calloc( maxjobs, sizeof( *cmdtab ) );
+	reaped = (int *)malloc( maxjobs * sizeof( *reaped ) );
+
+	if( !cmdtab || !reaped )
+	{
+	    printf( "no memory for %d job slots!\n", maxjobs );
+	    exit( EXITBAD );
+	}
+}
+
+# ifdef USE_PIDFD
+
+/*
+ * execwatch() - register a new child's pidfd with the epoll set
+ *
+ * If the kernel won't give us a pidfd (pre-5.3, or out of fds), the
+ * child is counted in nopidfd and execreap() falls back to wait().
+ */
+
+static void
+execwatch( int slot )
+{
+	struct epoll_event ev;
+	int fd = -1;
+
+	execepoll();
+
+	/* pidfds are always close-on-exec, so children don't see them. */
+
+	if( epollfd >= 0 )
+	    fd = syscall( SYS_pidfd_open, cmdtab[ slot ].pid, 0 );
+
+	if( fd >= 0 )
+	{
+	    memset( (char *)&ev, '\0', sizeof( ev ) );
+	    ev.events = EPOLLIN;
+	    ev.data.u32 = slot;
+
+	    if( epoll_ctl( epollfd, EPOLL_CTL_ADD, fd, &ev ) < 0 )
+		close( fd ), fd = -1;
+	}
+
+	if( fd < 0 )
+	    nopidfd++;
+
+	cmdtab[ slot ].pidfd = fd;
+}
+
+/*
+ * execepoll() - create the epoll set, if we haven't tried already
+ */
+
+static void
+execepoll()
+{
+	static int tried = 0;
+
+	if( !tried++ )
+	    epollfd = epoll_create1( EPOLL_CLOEXEC );
+}
+
+# endif /* USE_PIDFD */
+
+# ifdef USE_SHPOOL
+
+/*
+ * execpool() - hand a command to the slot's pooled shell
+ *
+ * Returns 0 if there's no pool (or no shell could be had), in which
+ * case execcmd() runs the command itself.
+ */
+
+static int
+execpool(
+	int		slot,
+	const char	*string )
+{
+	static int enabled = -1;
+	struct _cmdtab *c = &cmdtab[ slot ];
+	const char *s;
+	char *buf, *p;
+	int len;
+
+	/* Only if asked for, and only if pidfds work, as execreap() */
+	/* can't wait() for children while shells sit in the pool. */
+
+	if( enabled < 0 )
+	{
+	    LIST *l = var_get( "JAMSHELLPOOL" );
+	    int fd;
+
+	    enabled = 0;
+	    execepoll();
+
+	    if( l && l->string[0] && epollfd >= 0 && 
+		( fd = syscall( SYS_pidfd_open, getpid(), 0 ) ) >= 0 )
+	    {
+		close( fd );
+		enabled = 1;
+	    }
+	}
+
+	if( !enabled || nopidfd || ( !c->wpid && execpoolstart( slot ) < 0 ) )
+	    return 0;
+
+	/* ( eval '...' ) 8<&- 9>&- / echo $? >&9, with ' as '\'' */
+
+	for( len = 64, s = string; *s; s++ )
+	    len += *s == '\'' ? 4 : 1;
+
+	p = buf = malloc( len );
+	p += sprintf( p, "( eval '" );
+
+	for( s = string; *s; s++ )
+	    if( *s == '\'' )
+		p += sprintf( p, "'\\''" );
+	    else
+		*p++ = *s;
+
+	p += sprintf( p, "' ) 8<&- 9>&-\necho $? >&9\n" );
+
+	if( execpoolwrite( c->wcmd, buf, p - buf ) < 0 )
+	{
+	    /* Shell went away: run this one the usual way. */
+
+	    execpoolstop( slot );
+	    free( buf );
+	    return 0;
+	}
+
+	free( buf );
+
+	c->pooled = 1;
+	npooled++;
+
+	return 1;
+}
+
+/*
+ * execpoolstart() - start a pooled shell for a slot
+ */
+
+static int
+execpoolstart( int slot )
+{
+	struct _cmdtab *c = &cmdtab[ slot ];
+	struct epoll_event ev;
+	int cmdp[2], statp[2];
+	int pid, i;
+
+	if( pipe( cmdp ) < 0 )
+	    return -1;
+
+	if( pipe( statp ) < 0 )
+	{
+	    close( cmdp[0] );
+	    close( cmdp[1] );
+	    return -1;
+	}
+
+	/* No other child should hold these open. */
+
+	for( i = 0; i < 2; i++ )
+	{
+	    fcntl( cmdp[i], F_SETFD, FD_CLOEXEC );
+	    fcntl( statp[i], F_SETFD, FD_CLOEXEC );
+	}
+
+	if( ( pid = fork() ) == 0 )
+	{
+	    /* Out of the way first, in case either pipe is on 8 or 9. */
+
+	    int r = fcntl( cmdp[0], F_DUPFD_CLOEXEC, 10 );
+	    int w = fcntl( statp[1], F_DUPFD_CLOEXEC, 10 );
+
+	    dup2( r, 8 );
+	    dup2( w, 9 );
+	    execl( "/bin/sh", "sh", "/dev/fd/8", (char *)0 );
+	    _exit( 127 );
+	}
+
+	close( cmdp[0] );
+	close( statp[1] );
+
+	if( pid == -1 )
+	{
+	    close( cmdp[1] );
+	    close( statp[0] );
+	    return -1;
+	}
+
+	c->wpid = pid;
+	c->wcmd = cmdp[1];
+	c->wstat = statp[0];
+
+	memset( (char *)&ev, '\0', sizeof( ev ) );
+	ev.events = EPOLLIN;
+	ev.data.u32 = slot | POOLED;
+
+	if( epoll_ctl( epollfd, EPOLL_CTL_ADD, c->wstat, &ev ) < 0 )
+	{
+	    execpoolstop( slot );
+	    return -1;
+	}
+
+	if( DEBUG_EXECCMD )
+	    printf( "pooled shell %d for slot %d\n", pid, slot + 1 );
+
+	return 0;
+}
+
+/*
+ * execpoolwrite() - write to a pooled shell, surviving its death
+ *
+ * SIGPIPE is held off while writing, and any raised discarded, so that
+ * a shell that's gone just makes the write fail.
+ */
+
+static int
+execpoolwrite(
+	int		fd,
+	const char	*buf,
+	int		len )
+{
+	sigset_t pipeset, oldset;
+	struct timespec zero;
+	int n = 0;
+
+	sigemptyset( &pipeset );
+	sigaddset( &pipeset, SIGPIPE );
+	sigprocmask( SIG_BLOCK, &pipeset, &oldset );
+
+	while( len > 0 )
+	{
+	    if( ( n = write( fd, buf, len ) ) < 0 )
+	    {
+		if( errno == EINTR )
+		    continue;
+		break;
+	    }
+
+	    buf += n;
+	    len -= n;
+	}
+
+	if( n < 0 && errno == EPIPE )
+	{
+	    zero.tv_sec = zero.tv_nsec = 0;
+	    sigtimedwait( &pipeset, 0, &zero );
+	}
+
+	sigprocmask( SIG_SETMASK, &oldset, 0 );
+
+	return n < 0 ? -1 : 0;
+}
+
+/*
+ * execpooldone() - pick up the exit status from a pooled shell
+ *
+ * If the shell has died instead (say on an interrupt), its command 
+ * is taken as killed, and a new shell is started when next needed.
+ */
+
+static void
+execpooldone( int slot )
+{
+	struct _cmdtab *c = &cmdtab[ slot ];
+	char buf[ 32 ];
+	int n;
+
+	while( ( n = read( c->wstat, buf, sizeof( buf ) - 1 ) ) < 0 && 
+		errno == EINTR )
+	    ;
+
+	if( n <= 0 )
+	    execpoolstop( slot );
+
+	if( !c->pooled )
+	    return;
+
+	/* Make it look like a wait() status. */
+
+	if( n > 0 )
+	{
+	    buf[n] = 0;
+	    c->status = ( atoi( buf ) & 0xff ) << 8;
+	}
+	else
+	{
+	    c->status = SIGKILL;
+	}
+
+	/* The command ran in a subshell we didn't wait() for. */
+
+	c->pid = -1;
+	c->rss = 0;
+	reaped[ nreaped++ ] = slot;
+}
+
+/*
+ * execpoolstop() - close down a slot's pooled shell
+ */
+
+static void
+execpoolstop( int slot )
+{
+	struct _cmdtab *c = &cmdtab[ slot ];
+
+	if( !c->wpid )
+	    return;
+
+	/* Closing the script pipe makes the shell exit. */
+
+	close( c->wcmd );
+	close( c->wstat );
+	waitpid( c->wpid, (int *)0, 0 );
+
+	c->wpid = 0;
+}
+
+# endif /* USE_SHPOOL */
+
+# ifdef USE_REMOTE
+
+/*
+ * execremote() - hand a command to the slot's jamworker
+ *
+ * Returns 0 if there are no $(JAMWORKERS), or the slot's can't be
+ * reached, in which case execcmd() runs the command itself.
+ */
+
+static int
+execremote(
+	int		slot,
+	const char	*string,
+	LOL		*args )
+{
+	struct _cmdtab *c = &cmdtab[ slot ];
+	struct epoll_event ev;
+
+	execepoll();
+
+	if( epollfd < 0 || ( c->rfd = remote_start( slot, string, args ) ) < 0 )
+	    return 0;
+
+	c->remote = 1;
+	nremote++;
+
+	memset( (char *)&ev, '\0', sizeof( ev ) );
+	ev.events = EPOLLIN;
+	ev.data.u32 = slot | REMOTE;
+
+	/* Can't watch for the response?  Wait for it now, then. */
+
+	if( epoll_ctl( epollfd, EPOLL_CTL_ADD, c->rfd, &ev ) < 0 )
+	{
+	    remote_done( slot, 1, &c->status );
+	    c->pid = -1;
+	    c->rss = 0;
+	    reaped[ nreaped++ ] = slot;
+	}
+
+	return 1;
+}
+
+/*
+ * execremotedone() - pick up a command's results from its jamworker
+ *
+ * Called whenever the connection is readable: the command is only
+ * done once its whole response has come.
+ */
+
+static void
+execremotedone( int slot )
+{
+	struct _cmdtab *c = &cmdtab[ slot ];
+
+	if( !remote_done( slot, 0, &c->status ) )
+	    return;
+
+	/* The connection is kept for the slot's next command, */
+	/* but it's only watched while one is running. */
+
+	epoll_ctl( epollfd, EPOLL_CTL_DEL, c->rfd, (struct epoll_event *)0 );
+
+	c->pid = -1;
+	c->rss = 0;
+	reaped[ nreaped++ ] = slot;
+}
+
+# endif /* USE_REMOTE */
+
 # ifdef USE_MYWAIT
 
 static int
@@ -388,12 +1589,12 @@ my_wait( int *status )
 	static HANDLE *active_handles = 0;
 
 	if (!active_handles)
-	    active_handles = (HANDLE *)malloc(globs.jobs * sizeof(HANDLE) );
+	    active_handles = (HANDLE *)malloc(maxjobs * sizeof(HANDLE) );
 
 	/* first see if any non-waited-for processes are dead,
 	 * and return if so.
 	 */
-	for ( i = 0; i < globs.jobs; i++ ) {
+	for ( i = 0; i < maxjobs; i++ ) {
 	    if ( cmdtab[i].pid ) {
 		if ( GetExitCodeProcess((HANDLE)cmdtab[i].pid, &exitcode) ) {
 		    if ( exitcode == STILL_ACTIVE )
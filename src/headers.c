@@ -13,11 +13,43 @@
  * 
  *	$(HDRRULE) <target> : <include files> ;
  *
+ * On UNIX, if $(JAMHDRCACHE) names a file, the include files found
+ * in each file are kept there from one run to the next, along with
+ * the file's device, inode, size and modification time and a hash of
+ * the $(HDRSCAN) patterns used.  While those all match, headers()
+ * passes the kept list to $(HDRRULE) rather than reading the file.
+ * A file changed in the second it was scanned isn't kept, as a later
+ * change in that same second wouldn't show.
+ *
+ * Where there are POSIX threads and -j is more than 1, make0() has
+ * headers_prefetch() start reading the files of targets it's about to
+ * get to, with the regexps compiled ahead: as many threads as -j read
+ * them and run the regexps, so that on slow (say NFS) disks the reads
+ * overlap.  Threads touch no jam data, only the file and their own
+ * copy of the regexps, and leave the includes found in a buffer; the
+ * LIST is made, and $(HDRRULE) called, in headers() as before, so the
+ * rules run in the same order and see the same includes either way.
+ *
  * External routines:
  *    headers() - scan a target for include files and call HDRRULE
+ *    headers_prefetch() - start scanning a target's file on a thread
+ *    doneheaders() - write the header cache back out
  *
  * Internal routines:
  *    headers1() - using regexp, scan a file and build include LIST
+ *    headers2() - scan a file with compiled regexps, into a buffer
+ *    hdrfind() - find a string in text, or return the end of the text
+ *    hdrread() - read a whole file, mapping it if possible
+ *    hdrfree() - free what hdrread() read
+ *    hdrjob_start() - queue a file for the threads to scan
+ *    hdrjob_take() - wait for (or do) a queued scan of a file
+ *    hdrjob_run() - a thread scanning queued files
+ *    hdrcache_scan() - headers1(), unless the file's includes are cached
+ *    hdrcache_fresh() - are a cache record's includes good for the file?
+ *    hdrcache_cached() - are a file's includes cached?
+ *    hdrcache_load() - read $(JAMHDRCACHE)
+ *    hdrcache_enter() - find or make the cache record for a file
+ *    hdrcache_hash() - hash the $(HDRSCAN) patterns
  *
  * 04/13/94 (seiwald) - added shorthand L0 for null list pointer
  * 09/10/00 (seiwald) - replaced call to compile_rule with evaluate_rule,
@@ -39,22 +71,124 @@
 # include "regexp.h"
 # include "headers.h"
 # include "newstr.h"
+# include "hash.h"
+# include "search.h"
+# include "builtins.h"
+
+# ifdef unix
+# define USE_HDRCACHE
+# define USE_MMAP
+# include <unistd.h>
+# include <fcntl.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+# endif
+
+# if defined( OS_LINUX ) || defined( OS_MACOSX ) || \
+     defined( OS_FREEBSD ) || defined( OS_NETBSD ) || \
+     defined( OS_OPENBSD ) || defined( OS_SOLARIS )
+# define USE_HDRTHREADS
+# include <pthread.h>
+# endif
+
+# define MAXINC 10
 
-static LIST *headers1( const char *file, LIST *hdrscan );
+static LIST *headers1( const char *file, LIST *hdrscan, time_t *when );
+static char *headers2( const char *file, regexp **re, int rec, int *len );
+static const char *hdrfind( const char *p, const char *end, 
+			const char *s, int len );
+static char *hdrread( const char *file, long *size, int *mapped );
+static void hdrfree( char *text, long size, int mapped );
+
+# ifdef USE_HDRTHREADS
 
 /*
- * headers() - scan a target for include files and call HDRRULE
+ * HDRJOB - a file being scanned ahead, by headers_prefetch()
  */
 
-# define MAXINC 10
+typedef struct _hdrjob HDRJOB;
+
+struct _hdrjob {
+	const char	*name;		/* bound name of the file */
+	LIST		*hdrscan;	/* what it's being scanned for */
+	regexp		*re[ MAXINC ];	/* ... compiled, for the thread */
+	int		rec;
+	time_t		when;		/* before it was read */
+	int		state;		/* under hdrlock */
+	int		taken;		/* by headers1() */
+	char		*found;		/* includes, each null terminated */
+	int		len;
+	HDRJOB		*next;		/* on queue */
+} ;
+
+# define HDRJOB_QUEUED	0
+# define HDRJOB_RUNNING	1
+# define HDRJOB_DONE	2
+
+# define MAXHDRTHREADS	64
+
+static pthread_mutex_t hdrlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t hdrwork = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t hdrdone = PTHREAD_COND_INITIALIZER;
+static HDRJOB *queue = 0;
+static HDRJOB **queuetail = &queue;
+static struct hash *jobhash = 0;
+
+static void hdrjob_start( const char *file, LIST *hdrscan );
+static int hdrjob_take( const char *file, LIST *hdrscan, 
+			time_t *when, char **found, int *len );
+static void *hdrjob_run( void *arg );
+
+# endif
+
+# ifdef USE_HDRCACHE
+
+/*
+ * HDRCACHE - the include files found in a file, as kept in $(JAMHDRCACHE)
+ */
+
+typedef struct _hdrcache HDRCACHE;
+
+struct _hdrcache {
+	const char	*name;		/* bound name of the file */
+	long		dev;
+	long		ino;
+	long		size;
+	long		mtime;
+	unsigned long	scan;		/* hdrcache_hash() of $(HDRSCAN) */
+	int		keep;		/* includes good, to be saved */
+	LIST		*includes;
+} ;
+
+static struct hash *hdrhash = 0;
+static HDRCACHE **hdrs = 0;	/* in order, for doneheaders() */
+static int nhdrs = 0;
+static const char *hdrcachefile = 0;
+static int dirty = 0;
+
+static LIST *hdrcache_scan( const char *file, LIST *hdrscan );
+static int hdrcache_fresh( HDRCACHE *h, struct stat *st, unsigned long scan );
+static int hdrcache_cached( const char *file, LIST *hdrscan );
+static void hdrcache_load();
+static HDRCACHE *hdrcache_enter( const char *name );
+static unsigned long hdrcache_hash( LIST *hdrscan );
+
+# endif
+
+/*
+ * headers() - scan a target for include files and call HDRRULE
+ */
 
 void
 headers( TARGET *t )
 {
 	LIST	*hdrscan;
 	LIST	*hdrrule;
-	LIST	*hdrcache;
+	LIST	*includes;
 	LOL	lol;
+# ifndef USE_HDRCACHE
+	time_t	when;
+# endif
 
 	if( !( hdrscan = var_get( "HDRSCAN" ) ) || 
 	    !( hdrrule = var_get( "HDRRULE" ) ) )
@@ -66,10 +200,16 @@ headers( TARGET *t )
 	if( DEBUG_HEADER )
 	    printf( "header scan %s\n", t->name );
 
+# ifdef USE_HDRCACHE
+	includes = hdrcache_scan( t->boundname, hdrscan );
+# else
+	includes = headers1( t->boundname, hdrscan, &when );
+# endif
+
 	lol_init( &lol );
 
 	lol_add( &lol, list_new( L0, t->name, 1 ) );
-	lol_add( &lol, headers1( t->boundname, hdrscan ) );
+	lol_add( &lol, includes );
 
 	if( lol_get( &lol, 1 ) )
 	    list_free( evaluate_rule( 0, hdrrule->string, &lol, L0 ) );
@@ -79,53 +219,805 @@ headers( TARGET *t )
 	lol_free( &lol );
 }
 
+/*
+ * headers_prefetch() - start scanning a target's file on a thread
+ *
+ * make0() calls this for each target before it make0()'s them one by
+ * one.  The target is bound here on speculation, under its settings
+ * as they are now; headers1() only uses the scan if headers() later
+ * wants that same file scanned for the same $(HDRSCAN).
+ */
+
+void
+headers_prefetch( TARGET *t )
+{
+# ifdef USE_HDRTHREADS
+	static int threads = -1;
+	pthread_t tid;
+	const char *boundname;
+	LIST	*hdrscan;
+	time_t	time;
+	char	debug;
+
+	/* Threads start with the first target: as many as -j, if -j */
+	/* is more than 1. */
+
+	if( threads < 0 )
+	{
+	    threads = 0;
+
+	    while( globs.jobs > 1 && threads < globs.jobs && 
+		   threads < MAXHDRTHREADS )
+	    {
+		if( pthread_create( &tid, 0, hdrjob_run, 0 ) )
+		    break;
+
+		pthread_detach( tid );
+		threads++;
+	    }
+	}
+
+	if( !threads || t->fate != T_FATE_INIT || t->flags & T_FLAG_NOTFILE )
+	    return;
+
+	/* Nothing is set while these are pushed, so no copysettings(). */
+
+	pushsettings( t->settings );
+
+	if( ( hdrscan = var_get( "HDRSCAN" ) ) && var_get( "HDRRULE" ) )
+	{
+	    if( t->binding == T_BIND_UNBOUND )
+	    {
+		/* Quietly: -d6 should show the search make0() does. */
+
+		debug = DEBUG_SEARCH;
+		DEBUG_SEARCH = 0;
+		boundname = search( t->name, &time );
+		DEBUG_SEARCH = debug;
+
+		if( time )
+		    hdrjob_start( boundname, hdrscan );
+	    }
+	    else if( t->binding == T_BIND_EXISTS )
+	    {
+		hdrjob_start( t->boundname, hdrscan );
+	    }
+	}
+
+	popsettings( t->settings );
+# endif
+}
+
 /*
  * headers1() - using regexp, scan a file and build include LIST
+ *
+ * Sets *when to a time before the file was read.
  */
 
 static LIST *
 headers1( 
 	const char *file,
-	LIST *hdrscan )
+	LIST	*hdrscan,
+	time_t	*when )
 {
-	FILE	*f;
-	int	i;
 	int	rec = 0;
+	int	len;
 	LIST	*result = 0;
 	regexp	*re[ MAXINC ];
-	char	buf[ 1024 ];
+	char	*found, *s;
 
-	if( !( f = fopen( file, "r" ) ) )
-	    return result;
+	*when = time( 0 );
 
-	while( rec < MAXINC && hdrscan )
+# ifdef USE_HDRTHREADS
+	if( !hdrjob_take( file, hdrscan, when, &found, &len ) )
+# endif
 	{
-	    re[rec++] = regcomp( hdrscan->string );
-	    hdrscan = list_next( hdrscan );
+	    while( rec < MAXINC && hdrscan )
+	    {
+		re[rec++] = regcache( hdrscan->string );
+		hdrscan = list_next( hdrscan );
+	    }
+
+	    found = headers2( file, re, rec, &len );
 	}
 
-	while( fgets( buf, sizeof( buf ), f ) )
+	for( s = found; s < found + len; s += strlen( s ) + 1 )
 	{
+	    result = list_new( result, s, 0 );
+
+	    if( DEBUG_HEADER )
+		printf( "header found: %s\n", s );
+	}
+
+	free( found );
+
+	return result;
+}
+
+/*
+ * headers2() - scan a file with compiled regexps, into a buffer
+ *
+ * Returns the first subexpression of each match, null terminated, one
+ * after the other in malloc'ed memory ((char *)0 if none), and sets
+ * *len to their total length.  As it touches only the file and the
+ * regexps, it's safe on a thread.
+ *
+ * The file is read whole (mapped, where it can be) rather than a line
+ * at a time, and each regexp is only run on lines containing the
+ * literal string any match of it must include (per regliteral()):
+ * those lines are found with memchr() and memcmp(), which for most
+ * files skips almost all of them.  Lines are matched whole, however
+ * long, and the matches come out in the same order as if every line
+ * had been tried with every regexp.
+ */
+
+static char *
+headers2(
+	const char *file,
+	regexp	**re,
+	int	rec,
+	int	*len )
+{
+	const char *must[ MAXINC ];	/* regliteral() of each regexp */
+	int	mlen[ MAXINC ];
+	const char *next[ MAXINC ];	/* where that's next, or end */
+	const char *p, *end, *bol, *eol;
+	char	*text, *line = 0;
+	long	size, linesize = 0;
+	int	mapped;
+	int	i, l;
+	int	foundsize = 0;
+	char	*found = 0;
+
+	*len = 0;
+
+	if( !( text = hdrread( file, &size, &mapped ) ) )
+	    return found;
+
+	for( i = 0; i < rec; i++ )
+	{
+	    mlen[i] = re[i] ? regliteral( re[i], &must[i] ) : 0;
+	    next[i] = 0;
+	}
+
+	for( p = text, end = text + size; p < end; p = eol )
+	{
+	    /* Find the first line any regexp might match. */
+	    /* A regexp without a literal might match any. */
+
+	    bol = end;
+
 	    for( i = 0; i < rec; i++ )
-		if( regexec( re[i], buf ) && re[i]->startp[1] )
+	    {
+		if( !mlen[i] )
+		{
+		    bol = p;
+		    continue;
+		}
+
+		if( !next[i] || next[i] < p )
+		    next[i] = hdrfind( p, end, must[i], mlen[i] );
+
+		if( next[i] < bol )
+		    bol = next[i];
+	    }
+
+	    if( bol == end )
+		break;
+
+	    while( bol > p && bol[-1] != '\n' )
+		bol--;
+
+	    if( ( eol = (const char *)memchr( bol, '\n', end - bol ) ) )
+		eol++;
+	    else
+		eol = end;
+
+	    /* Copy and terminate the line, newline and all. */
+
+	    if( eol - bol + 1 > linesize )
+	    {
+		linesize = ( eol - bol + 1 ) * 2;
+		line = (char *)realloc( line, linesize );
+	    }
+
+	    memcpy( line, bol, eol - bol );
+	    line[ eol - bol ] = 0;
+
+	    for( i = 0; i < rec; i++ )
+		if( ( !mlen[i] || next[i] < eol ) &&
+		    regexec( re[i], line ) && re[i]->startp[1] )
 	    {
 		/* Copy and terminate extracted string. */
 
-		char buf2[ MAXSYM ];
-		int l = re[i]->endp[1] - re[i]->startp[1];
-		memcpy( buf2, re[i]->startp[1], l );
-		buf2[ l ] = 0;
-		result = list_new( result, buf2, 0 );
+		l = re[i]->endp[1] - re[i]->startp[1];
+
+		if( *len + l + 1 > foundsize )
+		{
+		    foundsize = ( *len + l + 1 ) * 2;
+		    found = (char *)realloc( found, foundsize );
+		}
+
+		memcpy( found + *len, re[i]->startp[1], l );
+		found[ *len + l ] = 0;
+		*len += l + 1;
+	    }
+	}
+
+	free( line );
+	hdrfree( text, size, mapped );
+
+	return found;
+}
+
+/*
+ * hdrfind() - find a string in text, or return the end of the text
+ */
+
+static const char *
+hdrfind(
+	const char *p,
+	const char *end,
+	const char *s,
+	int	len )
+{
+	while( end - p >= len && 
+	       ( p = (const char *)memchr( p, *s, end - p - len + 1 ) ) )
+	{
+	    if( !memcmp( p, s, len ) )
+		return p;
+	    p++;
+	}
+
+	return end;
+}
+
+/*
+ * hdrread() - read a whole file, mapping it if possible
+ *
+ * Returns 0 if the file can't be opened.  Otherwise *size is set to
+ * its size, and *mapped to whether hdrfree() must munmap() it rather
+ * than free() it.
+ */
+
+static char *
+hdrread(
+	const char *file,
+	long	*size,
+	int	*mapped )
+{
+	FILE	*f;
+	char	*text = 0;
+	long	n, alloc = 0;
+
+	*size = 0;
+	*mapped = 0;
+
+# ifdef USE_MMAP
+	{
+	    struct stat st;
+	    int fd;
+
+	    if( ( fd = open( file, O_RDONLY ) ) < 0 )
+		return text;
 
-		if( DEBUG_HEADER )
-		    printf( "header found: %s\n", buf2 );
+	    if( !fstat( fd, &st ) && S_ISREG( st.st_mode ) && st.st_size > 0 &&
+		( text = (char *)mmap( 0, st.st_size, PROT_READ, 
+			MAP_PRIVATE, fd, 0 ) ) != (char *)MAP_FAILED )
+	    {
+		close( fd );
+		*size = st.st_size;
+		*mapped = 1;
+		return text;
+	    }
+
+	    text = 0;
+
+	    if( !( f = fdopen( fd, "r" ) ) )
+	    {
+		close( fd );
+		return text;
 	    }
 	}
+# else
+	if( !( f = fopen( file, "r" ) ) )
+	    return text;
+# endif
+
+	/* Can't map it (or empty): read it. */
 
-	while( rec )
-	    free( (char *)re[--rec] );
+	do
+	{
+	    if( *size == alloc )
+		text = (char *)realloc( text, alloc = alloc * 2 + 8192 );
+
+	    n = fread( text + *size, 1, alloc - *size, f );
+	    *size += n;
+	}
+	while( n > 0 );
 
 	fclose( f );
 
-	return result;
+	return text;
+}
+
+/*
+ * hdrfree() - free what hdrread() read
+ */
+
+static void
+hdrfree(
+	char	*text,
+	long	size,
+	int	mapped )
+{
+# ifdef USE_MMAP
+	if( mapped )
+	{
+	    munmap( text, size );
+	    return;
+	}
+# endif
+	free( text );
+}
+
+# ifdef USE_HDRTHREADS
+
+/*
+ * hdrjob_start() - queue a file for the threads to scan
+ *
+ * A file is only queued once, and not if $(JAMHDRCACHE) has its
+ * includes already.
+ */
+
+static void
+hdrjob_start( 
+	const char *file,
+	LIST	*hdrscan )
+{
+	HDRJOB	j, *jp = &j;
+	int	bad = 0;
+
+# ifdef USE_HDRCACHE
+	if( hdrcache_cached( file, hdrscan ) )
+	    return;
+# endif
+
+	if( !jobhash )
+	    jobhash = hashinit( sizeof( HDRJOB ), "hdrjobs" );
+
+	j.name = file;
+
+	if( !hashenter( jobhash, (HASHDATA **)&jp ) )
+	    return;
+
+	jp->name = copystr( file );
+	jp->hdrscan = list_copy( L0, hdrscan );
+	jp->rec = 0;
+	jp->when = time( 0 );
+	jp->state = HDRJOB_QUEUED;
+	jp->taken = 0;
+	jp->found = 0;
+	jp->len = 0;
+	jp->next = 0;
+
+	/* Compile the regexps here, as regcomp() isn't thread safe. */
+	/* If one won't, the job is dropped (left taken, so that */
+	/* hdrjob_take() passes it by) and headers1() does the scan. */
+
+	for( ; !bad && jp->rec < MAXINC && hdrscan; 
+	       hdrscan = list_next( hdrscan ) )
+	    if( ( jp->re[ jp->rec ] = regcomp( hdrscan->string ) ) )
+		jp->rec++;
+	    else
+		bad++;
+
+	if( bad )
+	{
+	    while( jp->rec )
+		free( (char *)jp->re[ --jp->rec ] );
+
+	    list_free( jp->hdrscan );
+	    jp->hdrscan = 0;
+	    jp->taken = 1;
+	    return;
+	}
+
+	pthread_mutex_lock( &hdrlock );
+	*queuetail = jp;
+	queuetail = &jp->next;
+	pthread_cond_signal( &hdrwork );
+	pthread_mutex_unlock( &hdrlock );
+}
+
+/*
+ * hdrjob_take() - wait for (or do) a queued scan of a file
+ *
+ * Returns 0 if the file wasn't queued for the same $(HDRSCAN); if it
+ * was, sets *found and *len as headers2() would, and *when to a time
+ * before it was read.  A scan still queued is done here and now rather
+ * than waited for, so headers() never waits behind other files.
+ */
+
+static int
+hdrjob_take(
+	const char *file,
+	LIST	*hdrscan,
+	time_t	*when,
+	char	**found,
+	int	*len )
+{
+	HDRJOB	j, *jp = &j;
+	LIST	*l = hdrscan;
+	LIST	*m;
+	int	i, mine = 0;
+
+	j.name = file;
+
+	if( !jobhash || hashcheck( jobhash, (HASHDATA **)&jp ) == 0 || jp->taken )
+	    return 0;
+
+	/* Same patterns (as far as headers1() looks)? */
+
+	for( i = 0, m = jp->hdrscan; i < MAXINC && ( l || m ); i++ )
+	{
+	    if( !l || !m || strcmp( l->string, m->string ) )
+		return 0;
+
+	    l = list_next( l );
+	    m = list_next( m );
+	}
+
+	jp->taken = 1;
+
+	pthread_mutex_lock( &hdrlock );
+
+	if( jp->state == HDRJOB_QUEUED )
+	    jp->state = HDRJOB_RUNNING, mine = 1;
+	else while( jp->state != HDRJOB_DONE )
+	    pthread_cond_wait( &hdrdone, &hdrlock );
+
+	pthread_mutex_unlock( &hdrlock );
+
+	if( mine )
+	    jp->found = headers2( jp->name, jp->re, jp->rec, &jp->len );
+	else
+	    *when = jp->when;
+
+	*found = jp->found;
+	*len = jp->len;
+
+	while( jp->rec )
+	    free( (char *)jp->re[ --jp->rec ] );
+
+	list_free( jp->hdrscan );
+	jp->hdrscan = 0;
+	jp->found = 0;
+
+	return 1;
+}
+
+/*
+ * hdrjob_run() - a thread scanning queued files
+ *
+ * Jobs headers1() took for itself are left on the queue, and skipped.
+ */
+
+static void *
+hdrjob_run( void *arg )
+{
+	HDRJOB	*jp;
+
+	pthread_mutex_lock( &hdrlock );
+
+	for( ;; )
+	{
+	    while( !queue )
+		pthread_cond_wait( &hdrwork, &hdrlock );
+
+	    jp = queue;
+
+	    if( !( queue = jp->next ) )
+		queuetail = &queue;
+
+	    if( jp->state != HDRJOB_QUEUED )
+		continue;
+
+	    jp->state = HDRJOB_RUNNING;
+	    pthread_mutex_unlock( &hdrlock );
+
+	    jp->found = headers2( jp->name, jp->re, jp->rec, &jp->len );
+
+	    pthread_mutex_lock( &hdrlock );
+	    jp->state = HDRJOB_DONE;
+	    pthread_cond_broadcast( &hdrdone );
+	}
+
+	return arg;
+}
+
+# endif /* USE_HDRTHREADS */
+
+# ifdef USE_HDRCACHE
+
+/*
+ * hdrcache_scan() - headers1(), unless the file's includes are cached
+ */
+
+static LIST *
+hdrcache_scan( 
+	const char *file,
+	LIST *hdrscan )
+{
+	struct stat st;
+	HDRCACHE *h;
+	LIST	*includes;
+	unsigned long scan;
+	time_t	when;
+
+	hdrcache_load();
+
+	if( !hdrhash || stat( file, &st ) < 0 )
+	    return headers1( file, hdrscan, &when );
+
+	h = hdrcache_enter( file );
+	scan = hdrcache_hash( hdrscan );
+
+	if( hdrcache_fresh( h, &st, scan ) )
+	{
+	    if( DEBUG_HEADER )
+		printf( "header cached %s\n", file );
+
+	    return list_copy( L0, h->includes );
+	}
+
+	/* New or changed: scan it, and note what was found.  Only keep */
+	/* it if it can't have changed after we looked. */
+
+	includes = headers1( file, hdrscan, &when );
+
+	list_free( h->includes );
+	h->includes = list_copy( L0, includes );
+	h->dev = (long)st.st_dev;
+	h->ino = (long)st.st_ino;
+	h->size = (long)st.st_size;
+	h->mtime = (long)st.st_mtime;
+	h->scan = scan;
+	h->keep = st.st_mtime < when;
+	dirty++;
+
+	return includes;
+}
+
+/*
+ * hdrcache_fresh() - are a cache record's includes good for the file?
+ */
+
+static int
+hdrcache_fresh(
+	HDRCACHE *h,
+	struct stat *st,
+	unsigned long scan )
+{
+	return h->keep &&
+	    h->dev == (long)st->st_dev &&
+	    h->ino == (long)st->st_ino &&
+	    h->size == (long)st->st_size &&
+	    h->mtime == (long)st->st_mtime &&
+	    h->scan == scan;
+}
+
+/*
+ * hdrcache_cached() - are a file's includes cached?
+ *
+ * For headers_prefetch(), which needn't read files hdrcache_scan()
+ * won't.
+ */
+
+static int
+hdrcache_cached(
+	const char *file,
+	LIST *hdrscan )
+{
+	HDRCACHE h, *hp = &h;
+	struct stat st;
+
+	hdrcache_load();
+	h.name = file;
+
+	return hdrhash && hashcheck( hdrhash, (HASHDATA **)&hp ) && hp->keep &&
+	    !stat( file, &st ) && hdrcache_fresh( hp, &st, hdrcache_hash( hdrscan ) );
+}
+
+/*
+ * hdrcache_load() - read $(JAMHDRCACHE)
+ *
+ * The file is plain text: a line for each file scanned,
+ *
+ *	h <tab> dev <tab> inode <tab> size <tab> mtime <tab> scan <tab>
+ *		count <tab> name
+ *
+ * followed by count lines, each an include file found in it.  A file
+ * missing any of its includes is dropped.
+ */
+
+static void
+hdrcache_load()
+{
+	static int loaded = 0;
+	LIST	*l = var_get( "JAMHDRCACHE" );
+	char	buf[ MAXJPATH + 128 ];
+	HDRCACHE *h = 0;
+	int	n = 0;
+	FILE	*f;
+
+	if( loaded++ || !l || !*l->string )
+	    return;
+
+	hdrcachefile = copystr( l->string );
+	hdrhash = hashinit( sizeof( HDRCACHE ), "hdrcache" );
+
+	if( !( f = fopen( hdrcachefile, "r" ) ) )
+	    return;
+
+	while( fgets( buf, sizeof( buf ), f ) )
+	{
+	    char *p = buf + strlen( buf );
+	    long dev, ino, size, mtime;
+	    unsigned long scan;
+	    int count, i = -1;
+
+	    if( p == buf || p[-1] != '\n' )
+		break;
+
+	    p[-1] = 0;
+
+	    /* The includes of the file before. */
+
+	    if( n )
+	    {
+		h->includes = list_new( h->includes, buf, 0 );
+
+		if( !--n )
+		    h->keep = 1;
+
+		continue;
+	    }
+
+	    if( sscanf( buf, "h\t%ld\t%ld\t%ld\t%ld\t%lx\t%d\t%n", 
+		    &dev, &ino, &size, &mtime, &scan, &count, &i ) < 6 || 
+		i < 0 || count < 0 || !buf[i] )
+		    continue;
+
+	    h = hdrcache_enter( buf + i );
+	    h->dev = dev;
+	    h->ino = ino;
+	    h->size = size;
+	    h->mtime = mtime;
+	    h->scan = scan;
+	    h->keep = !count;
+	    list_free( h->includes );
+	    h->includes = 0;
+
+	    n = count;
+	}
+
+	fclose( f );
+
+	if( DEBUG_HEADER )
+	    printf( "read %d header scans from %s\n", nhdrs, hdrcachefile );
+}
+
+/*
+ * hdrcache_enter() - find or make the cache record for a file
+ */
+
+static HDRCACHE *
+hdrcache_enter( const char *name )
+{
+	HDRCACHE h, *hp = &h;
+
+	h.name = name;
+
+	if( hashenter( hdrhash, (HASHDATA **)&hp ) )
+	{
+	    hp->name = newstr( name );
+	    hp->dev = hp->ino = hp->size = hp->mtime = 0;
+	    hp->scan = 0;
+	    hp->keep = 0;
+	    hp->includes = 0;
+
+	    if( !( nhdrs % 256 ) )
+		hdrs = (HDRCACHE **)realloc( (char *)hdrs,
+			( nhdrs + 256 ) * sizeof( HDRCACHE * ) );
+
+	    hdrs[ nhdrs++ ] = hp;
+	}
+
+	return hp;
+}
+
+/*
+ * hdrcache_hash() - hash the $(HDRSCAN) patterns
+ *
+ * Only the first MAXINC are used by headers1(), so only they count.
+ */
+
+static unsigned long
+hdrcache_hash( LIST *hdrscan )
+{
+	unsigned long h = 5381;
+	const char *s;
+	int i;
+
+	for( i = 0; i < MAXINC && hdrscan; i++, hdrscan = list_next( hdrscan ) )
+	{
+	    for( s = hdrscan->string; *s; s++ )
+		h = ( h * 33 + (unsigned char)*s ) & 0xffffffffUL;
+
+	    h = ( h * 33 ) & 0xffffffffUL;
+	}
+
+	return h;
+}
+
+# endif /* USE_HDRCACHE */
+
+/*
+ * doneheaders() - write the header cache back out
+ *
+ * Written only if some file had to be scanned, to a temp file first
+ * and renamed, as jams run at once may share it.  Files this run didn't
+ * scan are kept, as another jam (say in a subdirectory) may want them.
+ */
+
+void
+doneheaders()
+{
+# ifdef USE_HDRCACHE
+	char	tmp[ MAXJPATH ];
+	FILE	*f;
+	LIST	*l;
+	int	i;
+
+	if( !dirty || strlen( hdrcachefile ) + 16 > sizeof( tmp ) )
+	    return;
+
+	dirty = 0;
+	sprintf( tmp, "%s.%d", hdrcachefile, (int)getpid() );
+
+	if( !( f = fopen( tmp, "w" ) ) )
+	{
+	    printf( "warning: can't write %s\n", tmp );
+	    return;
+	}
+
+	for( i = 0; i < nhdrs; i++ )
+	    if( hdrs[i]->keep )
+	{
+	    HDRCACHE *h = hdrs[i];
+
+	    /* Names with newlines can't be written. */
+
+	    for( l = h->includes; l; l = list_next( l ) )
+		if( strchr( l->string, '\n' ) )
+		    break;
+
+	    if( l || strchr( h->name, '\n' ) )
+		continue;
+
+	    fprintf( f, "h\t%ld\t%ld\t%ld\t%ld\t%lx\t%d\t%s\n",
+		h->dev, h->ino, h->size, h->mtime, h->scan,
+		list_length( h->includes ), h->name );
+
+	    for( l = h->includes; l; l = list_next( l ) )
+		fprintf( f, "%s\n", l->string );
+	}
+
+	if( fclose( f ) || rename( tmp, hdrcachefile ) )
+	{
+	    printf( "warning: can't write %s\n", hdrcachefile );
+	    unlink( tmp );
+	}
+# endif
 }
@@ -0,0 +1,572 @@
+/*
+ * Copyright 1993-2002 Christopher Seiwald and Perforce Software, Inc.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * history.c - remember how actions went on previous runs
+ *
+ * If $(JAMHISTORY) names a file, jam keeps there a record of each
+ * action it has run: how long it took (wall time), whether it failed,
+ * its peak memory use (resident set, where execwait() can tell), and
+ * a hash of the command text.  The records are keyed by the rule
+ * name and the first target of the action, loaded when make() starts
+ * and written back (one line per key, so the file stays compact) when
+ * it is done.
+ *
+ * Make1() uses the durations to weigh the critical path, and -dt
+ * shows how long each action took, noting those that got markedly
+ * slower than last time.  Under -m, make1() holds off starting actions
+ * whose peaks, added to those of the actions running, would go over.
+ * Under -q, make1() starts first the actions that failed last time,
+ * and then those whose sources changed since the last run.
+ *
+ * The file is plain text, one record per line:
+ *
+ *	ms <tab> status <tab> hash <tab> kb <tab> rule target
+ *
+ * Records without the kb (from before it was kept) are still read.
+ * A comment line "# written secs" gives the time the file was written:
+ * sources newer than that have changed since the last run.
+ *
+ * For an 'actions restat' target whose commands left its contents as
+ * they were, there is also a line
+ *
+ *	restat <tab> mtime <tab> secs <tab> target
+ *
+ * saying that the target, as long as its file time is still mtime,
+ * has had the same contents since secs.  Make0() then gives it that
+ * older time, so its parents don't look out of date.
+ *
+ * External routines:
+ *
+ *	history_init() - load $(JAMHISTORY), if set
+ *	history_find() - look up the record for an action
+ *	history_record() - note how an action went this run
+ *	history_cost() - expected wall time of an action, in ms
+ *	history_rss() - expected peak memory of an action, in KB
+ *	history_clock() - wall clock, in ms
+ *	history_known() - number of actions with times on record
+ *	history_since() - when the records were written
+ *	history_restat() - when a restat target's contents last changed
+ *	history_unchanged() - note a restat target's contents are old
+ *	history_done() - write the records back out
+ *
+ * Internal routines:
+ *
+ *	history_enter() - find or make the record for a key
+ *	history_key() - build the key of an action from rule and target
+ *	history_hash() - hash the text of a command
+ */
+
+# include "jam.h"
+# include "lists.h"
+# include "variable.h"
+# include "hash.h"
+# include "newstr.h"
+# include "history.h"
+# include "execcmd.h"
+
+# ifdef OS_NT
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+# include <process.h>
+# define getpid _getpid
+# else
+# ifdef unix
+# include <sys/time.h>
+# include <unistd.h>
+# define USE_GETTIMEOFDAY
+# endif
+# endif
+
+# ifdef OS_MAC
+# define getpid() 0		/* only one jam at a time */
+# endif
+
+static struct hash *historyhash = 0;
+static const char *historyfile = 0;
+static HISTORY **records = 0;	/* in file order, for history_done() */
+static int nrecords = 0;
+static int dirty = 0;
+static long known = 0;		/* total ms of records loaded */
+static int nknown = 0;
+static long knownrss = 0;	/* total KB of records with peaks */
+static int nknownrss = 0;
+static time_t since = 0;	/* when the file was written */
+
+/* What restat targets have kept the same contents since when. */
+
+typedef struct {
+	const char	*name;		/* bound name of target */
+	time_t		mtime;		/* file time when last checked */
+	time_t		since;		/* contents unchanged since */
+} UNCHANGED ;
+
+static struct hash *restathash = 0;
+static UNCHANGED **restats = 0;	/* in file order, for history_done() */
+static int nrestats = 0;
+
+static HISTORY *history_enter( const char *key );
+static UNCHANGED *history_restated( const char *target );
+static int history_key( char *key, const char *rule, const char *target );
+static unsigned long history_hash( const char *buf );
+
+/*
+ * history_init() - load $(JAMHISTORY), if set
+ */
+
+void
+history_init()
+{
+	LIST	*l = var_get( "JAMHISTORY" );
+	char	buf[ MAXJPATH + MAXSYM + 64 ];
+	FILE	*f;
+
+	if( !l || historyfile )
+	    return;
+
+	historyfile = copystr( l->string );
+	historyhash = hashinit( sizeof( HISTORY ), "history" );
+	restathash = hashinit( sizeof( UNCHANGED ), "restat" );
+
+	if( !( f = fopen( historyfile, "r" ) ) )
+	    return;
+
+	while( fgets( buf, sizeof( buf ), f ) )
+	{
+	    HISTORY *h;
+	    long ms, rss = 0;
+	    int status, n = -1;
+	    unsigned long hash;
+	    char *p = buf + strlen( buf );
+
+	    /* Skip comments and lines that got cut off. */
+
+	    if( !strncmp( buf, "# written ", 10 ) )
+		since = (time_t)atol( buf + 10 );
+
+	    if( buf[0] == '#' || p == buf || p[-1] != '\n' )
+		continue;
+
+	    p[-1] = 0;
+
+	    /* Restat target: mtime, unchanged since, bound name. */
+
+	    if( !strncmp( buf, "restat\t", 7 ) )
+	    {
+		long mtime, when;
+		UNCHANGED *r;
+
+		if( sscanf( buf + 7, "%ld\t%ld\t%n", &mtime, &when, &n ) < 2 ||
+		    n < 0 || !buf[ 7 + n ] )
+			continue;
+
+		r = history_restated( buf + 7 + n );
+		r->mtime = (time_t)mtime;
+		r->since = (time_t)when;
+		continue;
+	    }
+
+	    /* Older records have no kb: the key follows the hash. */
+
+	    if( sscanf( buf, "%ld\t%d\t%lx\t%ld\t%n", 
+		    &ms, &status, &hash, &rss, &n ) < 4 || n < 0 )
+	    {
+		rss = 0;
+
+		if( sscanf( buf, "%ld\t%d\t%lx\t%n",
+			&ms, &status, &hash, &n ) < 3 || n < 0 )
+		    continue;
+	    }
+
+	    if( !buf[n] )
+		continue;
+
+	    h = history_enter( buf + n );
+	    h->ms = ms;
+	    h->status = status;
+	    h->hash = hash;
+	    h->rss = rss;
+
+	    known += ms;
+	    nknown++;
+
+	    if( rss )
+		knownrss += rss, nknownrss++;
+	}
+
+	fclose( f );
+
+	if( DEBUG_TIMES )
+	    printf( "...read %d action time(s) from %s...\n",
+		nknown, historyfile );
+}
+
+/*
+ * history_restated() - find or make the restat record for a target
+ */
+
+static UNCHANGED *
+history_restated( const char *target )
+{
+	UNCHANGED r, *rp = &r;
+
+	r.name = target;
+
+	if( hashenter( restathash, (HASHDATA **)&rp ) )
+	{
+	    rp->name = newstr( target );
+	    rp->mtime = 0;
+	    rp->since = 0;
+
+	    if( !( nrestats % 256 ) )
+		restats = (UNCHANGED **)realloc( (char *)restats,
+			( nrestats + 256 ) * sizeof( UNCHANGED * ) );
+
+	    restats[ nrestats++ ] = rp;
+	}
+
+	return rp;
+}
+
+/*
+ * history_enter() - find or make the record for a key
+ */
+
+static HISTORY *
+history_enter( const char *key )
+{
+	HISTORY h, *hp = &h;
+
+	h.name = key;
+
+	if( hashenter( historyhash, (HASHDATA **)&hp ) )
+	{
+	    hp->name = newstr( key );
+	    hp->ms = 0;
+	    hp->status = EXEC_CMD_OK;
+	    hp->hash = 0;
+	    hp->rss = 0;
+	    hp->ran = 0;
+
+	    if( !( nrecords % 256 ) )
+		records = (HISTORY **)realloc( (char *)records,
+			( nrecords + 256 ) * sizeof( HISTORY * ) );
+
+	    records[ nrecords++ ] = hp;
+	}
+
+	return hp;
+}
+
+/*
+ * history_find() - look up the record for an action
+ */
+
+HISTORY *
+history_find(
+	const char *rule,
+	const char *target )
+{
+	HISTORY h, *hp = &h;
+	char	key[ MAXJPATH + MAXSYM + 2 ];
+
+	if( !historyhash || !history_key( key, rule, target ) )
+	    return 0;
+
+	h.name = key;
+
+	return hashcheck( historyhash, (HASHDATA **)&hp ) ? hp : 0;
+}
+
+/*
+ * history_record() - note how an action went this run
+ *
+ * An action split into several commands ('actions piecemeal') is
+ * recorded as their total, and the largest of their peaks.
+ */
+
+HISTORY *
+history_record(
+	const char *rule,
+	const char *target,
+	long	ms,
+	int	status,
+	long	rss,
+	const char *buf )
+{
+	HISTORY	*h;
+	char	key[ MAXJPATH + MAXSYM + 2 ];
+	unsigned long hash = history_hash( buf );
+
+	if( !historyhash || !history_key( key, rule, target ) )
+	    return 0;
+
+	h = history_enter( key );
+
+	if( h->ran )
+	{
+	    h->ms += ms;
+	    h->hash = ( h->hash * 33 + hash ) & 0xffffffffUL;
+	    if( status > h->status )
+		h->status = status;
+	    if( rss > h->rss )
+		h->rss = rss;
+	    return h;
+	}
+
+	/* Same command as last time, but much slower? */
+
+	if( DEBUG_TIMES && h->hash == hash && h->ms &&
+	    ms > 2 * h->ms && ms - h->ms > 1000 )
+		printf( "...%s took %ld.%03lds, was %ld.%03lds...\n", key,
+		    ms / 1000, ms % 1000, h->ms / 1000, h->ms % 1000 );
+
+	h->ms = ms;
+	h->status = status;
+	h->hash = hash;
+	h->rss = rss;
+	h->ran = 1;
+
+	dirty++;
+
+	return h;
+}
+
+/*
+ * history_cost() - expected wall time of an action, in ms
+ *
+ * Actions we have no record of are guessed to take the average time.
+ * Without a history at all, every action costs 1.
+ */
+
+long
+history_cost(
+	const char *rule,
+	const char *target )
+{
+	HISTORY *h = history_find( rule, target );
+
+	if( h && h->ms )
+	    return h->ms;
+
+	return nknown && known / nknown ? known / nknown : 1;
+}
+
+/*
+ * history_rss() - expected peak memory of an action, in KB
+ *
+ * Actions we have no record of are guessed to take the average; 0 if
+ * no peaks are on record at all.
+ */
+
+long
+history_rss(
+	const char *rule,
+	const char *target )
+{
+	HISTORY *h = history_find( rule, target );
+
+	if( h && h->rss )
+	    return h->rss;
+
+	return nknownrss ? knownrss / nknownrss : 0;
+}
+
+/*
+ * history_clock() - wall clock, in ms
+ */
+
+long
+history_clock()
+{
+# ifdef OS_NT
+	return (long)GetTickCount();
+# else
+# ifdef USE_GETTIMEOFDAY
+	struct timeval tv;
+
+	gettimeofday( &tv, 0 );
+
+	return (long)( tv.tv_sec % 1000000 ) * 1000 + tv.tv_usec / 1000;
+# else
+	return (long)( time( 0 ) % 1000000 ) * 1000;
+# endif
+# endif
+}
+
+/*
+ * history_known() - number of actions with times on record
+ */
+
+int
+history_known()
+{
+	return nknown;
+}
+
+/*
+ * history_since() - when the records were written
+ *
+ * That's at the end of the last run that ran any actions; 0 if not
+ * known.
+ */
+
+time_t
+history_since()
+{
+	return since;
+}
+
+/*
+ * history_restat() - when a restat target's contents last changed
+ *
+ * That's mtime itself, unless the target was last seen with that
+ * file time and then had contents older than that.
+ */
+
+time_t
+history_restat(
+	const char *target,
+	time_t	mtime )
+{
+	UNCHANGED r, *rp = &r;
+
+	r.name = target;
+
+	if( restathash && hashcheck( restathash, (HASHDATA **)&rp ) &&
+	    rp->mtime == mtime && rp->since < mtime )
+		return rp->since;
+
+	return mtime;
+}
+
+/*
+ * history_unchanged() - note a restat target's contents are old
+ *
+ * The target, now with file time mtime, has had the same contents
+ * since when; when == mtime if its commands just changed them.
+ */
+
+void
+history_unchanged(
+	const char *target,
+	time_t	mtime,
+	time_t	when )
+{
+	UNCHANGED	*r;
+
+	if( !restathash )
+	    return;
+
+	r = history_restated( target );
+
+	if( r->mtime != mtime || r->since != when )
+	{
+	    r->mtime = mtime;
+	    r->since = when;
+	    dirty++;
+	}
+}
+
+/*
+ * history_done() - write the records back out
+ *
+ * Written to a temp file first and renamed, so that an interrupted
+ * jam doesn't leave a truncated history behind.
+ */
+
+void
+history_done()
+{
+	char	tmp[ MAXJPATH ];
+	FILE	*f;
+	int	i;
+
+	if( !dirty || globs.noexec )
+	    return;
+
+	dirty = 0;
+
+	if( strlen( historyfile ) + 16 > sizeof( tmp ) )
+	    return;
+
+	/* Jams sharing the file each write their own temp file. */
+
+	sprintf( tmp, "%s.%d", historyfile, (int)getpid() );
+
+	if( !( f = fopen( tmp, "w" ) ) )
+	{
+	    printf( "warning: can't write %s\n", tmp );
+	    return;
+	}
+
+	fprintf( f, "# jam action history: ms status hash kb rule target\n" );
+	fprintf( f, "# written %ld\n", (long)time( 0 ) );
+
+	for( i = 0; i < nrecords; i++ )
+	    fprintf( f, "%ld\t%d\t%lx\t%ld\t%s\n", records[i]->ms,
+		records[i]->status, records[i]->hash, records[i]->rss,
+		records[i]->name );
+
+	/* Restat targets whose contents are as new as their files */
+	/* need no record. */
+
+	for( i = 0; i < nrestats; i++ )
+	    if( restats[i]->since < restats[i]->mtime )
+		fprintf( f, "restat\t%ld\t%ld\t%s\n", (long)restats[i]->mtime,
+		    (long)restats[i]->since, restats[i]->name );
+
+# ifdef OS_NT
+	unlink( historyfile );
+# endif
+
+	if( fclose( f ) || rename( tmp, historyfile ) )
+	{
+	    printf( "warning: can't write %s\n", historyfile );
+	    unlink( tmp );
+	}
+}
+
+/*
+ * history_key() - build the key of an action from rule and target
+ *
+ * Key must hold MAXJPATH + MAXSYM + 2 bytes; returns 0 if the two
+ * don't fit.
+ */
+
+static int
+history_key(
+	char	*key,
+	const char *rule,
+	const char *target )
+{
+	size_t	r = strlen( rule );
+	size_t	t = strlen( target );
+
+	if( r + t + 2 > MAXJPATH + MAXSYM + 2 )
+	    return 0;
+
+	memcpy( key, rule, r );
+	key[ r ] = ' ';
+	memcpy( key + r + 1, target, t + 1 );
+
+	return 1;
+}
+
+/*
+ * history_hash() - hash the text of a command
+ */
+
+static unsigned long
+history_hash( const char *buf )
+{
+	unsigned long h = 5381;
+
+	while( *buf )
+	    h = ( h * 33 + (unsigned char)*buf++ ) & 0xffffffffUL;
+
+	return h;
+}
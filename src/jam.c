@@ -116,7 +116,9 @@
 # include "newstr.h"
 # include "scan.h"
 # include "timestamp.h"
+# include "headers.h"
 # include "make.h"
+# include "execcmd.h"
 
 /* Macintosh is "special" */
 
@@ -133,8 +135,13 @@
 struct globs globs = {
 	0,			/* noexec */
 	1,			/* jobs */
+	0,			/* jobsset */
 	0,			/* quitquick */
+	0,			/* anyhow */
 	0,			/* newestfirst */
+	0.0,			/* maxload */
+	0,			/* maxpressure */
+	0,			/* maxmem */
 # ifdef OS_MAC
 	{ 0 },			/* display - suppress actions output */
 # else
@@ -166,6 +173,48 @@ extern char **environ;
 # endif
 # endif
 
+static void
+usage()
+{
+	printf( "\nusage: jam [ options ] targets...\n\n" );
+
+	printf( "-a      Build all targets, even if they are current.\n" );
+	printf( "-dx     Display (a)actions (c)causes (d)dependencies\n" );
+	printf( "        (m)make tree (t)times (x)commands (0-9) debug levels.\n" );
+	printf( "-fx     Read x instead of Jambase.\n" );
+	printf( "-g      Build from newest sources first.\n" );
+	printf( "-jx     Run up to x shell commands concurrently.\n" );
+	printf( "        (-j0 or -jauto: one per available CPU).\n" );
+	printf( "-lx     Start no commands while the load is over x.\n" );
+	printf( "-mx     Keep actions' expected memory under x GB.\n" );
+	printf( "-n      Don't actually execute the updating actions.\n" );
+	printf( "-ox     Write the updating actions to file x.\n" );
+	printf( "-px     Start no commands while CPU or memory pressure\n" );
+	printf( "        is over x%% (Linux).\n" );
+	printf( "-q      Quit quickly as soon as a target fails.\n" );
+	printf( "-sx=y   Set variable x=y, overriding environment.\n" );
+	printf( "-tx     Rebuild x, even if it is up-to-date.\n" );
+	printf( "-v      Print the version of jam and exit.\n\n" );
+
+	exit( EXITBAD );
+}
+
+/*
+ * optnum() - a non-negative number for -l, -p or -m, or usage()
+ */
+
+static double
+optnum( const char *s )
+{
+	char	*e;
+	double	d = strtod( s, &e );
+
+	if( e == s || *e || !( d >= 0 ) )
+	    usage();
+
+	return d;
+}
+
 main( int argc, char **argv, char **arg_environ )
 {
 	int		n;
@@ -181,24 +230,9 @@ main( int argc, char **argv, char **arg_environ )
 
 	argc--, argv++;
 
-	if( ( n = getoptions( argc, argv, "d:j:f:gs:t:ano:qv", optv ) ) < 0 )
+	if( ( n = getoptions( argc, argv, "d:j:f:gl:m:p:s:t:ano:qv", optv ) ) < 0 )
 	{
-	    printf( "\nusage: jam [ options ] targets...\n\n" );
-
-            printf( "-a      Build all targets, even if they are current.\n" );
-            printf( "-dx     Display (a)actions (c)causes (d)dependencies\n" );
-	    printf( "        (m)make tree (x)commands (0-9) debug levels.\n" );
-            printf( "-fx     Read x instead of Jambase.\n" );
-	    printf( "-g      Build from newest sources first.\n" );
-            printf( "-jx     Run up to x shell commands concurrently.\n" );
-            printf( "-n      Don't actually execute the updating actions.\n" );
-            printf( "-ox     Write the updating actions to file x.\n" );
-            printf( "-q      Quit quickly as soon as a target fails.\n" );
-	    printf( "-sx=y   Set variable x=y, overriding environment.\n" );
-            printf( "-tx     Rebuild x, even if it is up-to-date.\n" );
-            printf( "-v      Print the version of jam and exit.\n\n" );
-
-	    exit( EXITBAD );
+	    usage();
 	}
 
 	argc -= n, argv += n;
@@ -223,14 +257,37 @@ main( int argc, char **argv, char **arg_environ )
 	    globs.quitquick = 1;
 
 	if( ( s = getoptval( optv, 'a', 0 ) ) )
-	    anyhow++;
+	    anyhow++, globs.anyhow = 1;
+
+	/* -j0 or -j auto: as many jobs as we have CPUs to run them on */
 
 	if( ( s = getoptval( optv, 'j', 0 ) ) )
-	    globs.jobs = atoi( s );
+	{
+	    if( !strcmp( s, "auto" ) )
+		globs.jobs = 0;
+	    else if( *s && strlen( s ) < 10 && strspn( s, "0123456789" ) == strlen( s ) )
+		globs.jobs = atoi( s );
+	    else
+		usage();
+
+	    if( !globs.jobs )
+		globs.jobs = execcpus();
+
+	    globs.jobsset = 1;
+	}
 
 	if( ( s = getoptval( optv, 'g', 0 ) ) )
 	    globs.newestfirst = 1;
 
+	if( ( s = getoptval( optv, 'l', 0 ) ) )
+	    globs.maxload = optnum( s );
+
+	if( ( s = getoptval( optv, 'p', 0 ) ) )
+	    globs.maxpressure = (int)optnum( s );
+
+	if( ( s = getoptval( optv, 'm', 0 ) ) )
+	    globs.maxmem = (long)( optnum( s ) * 1024 * 1024 );
+
 	/* Turn on/off debugging */
 
 	for( n = 0; s = getoptval( optv, 'd', n ); n++ )
@@ -265,6 +322,7 @@ main( int argc, char **argv, char **arg_environ )
 	    case 'd': DEBUG_DEPENDS = 1; break;
 	    case 'm': DEBUG_MAKEPROG = 1; break;
 	    case 'r': DEBUG_COMPILE = 1; break;
+	    case 't': DEBUG_TIMES = 1; break;
 	    case 'x': DEBUG_EXEC = 1; break;
 	    case '0': break;
 	    default: printf( "Invalid debug flag '%c'.\n", s[-1] );
@@ -368,6 +426,7 @@ main( int argc, char **argv, char **arg_environ )
 	var_done();
 	donerules();
 	donestamps();
+	doneheaders();
 	donestr();
 
 	/* close cmdout */
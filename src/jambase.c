@@ -1046,7 +1046,7 @@ const char *jambase[] = {
 "{\n",
 "$(CHGRP) $(GROUP) $(<)\n",
 "}\n",
-"actions Chmod1\n",
+"actions batch Chmod1\n",
 "{\n",
 "$(CHMOD) $(MODE) $(<)\n",
 "}\n",
@@ -1058,7 +1058,7 @@ const char *jambase[] = {
 "{\n",
 "$(RM) $(>)\n",
 "}\n",
-"actions File\n",
+"actions batch File\n",
 "{\n",
 "$(CP) $(>) $(<)\n",
 "}\n",
@@ -1070,7 +1070,7 @@ const char *jambase[] = {
 "{\n",
 "$(FORTRAN) $(FORTRANFLAGS) -o $(<) $(>)\n",
 "}\n",
-"actions HardLink\n",
+"actions batch HardLink\n",
 "{\n",
 "$(RM) $(<) && $(LN) $(>) $(<)\n",
 "}\n",
@@ -1090,7 +1090,7 @@ const char *jambase[] = {
 "{\n",
 "$(LINK) $(LINKFLAGS) -o $(<) $(UNDEFS) $(>) $(NEEDLIBS) $(LINKLIBS)\n",
 "}\n",
-"actions MkDir1\n",
+"actions batch MkDir1\n",
 "{\n",
 "$(MKDIR) $(<)\n",
 "}\n",
@@ -1111,7 +1111,7 @@ const char *jambase[] = {
 "{ print }\n",
 "' < $(>) > $(<)\n",
 "}\n",
-"actions SoftLink\n",
+"actions batch SoftLink\n",
 "{\n",
 "$(RM) $(<) && $(LN) -s $(>) $(<)\n",
 "}\n",
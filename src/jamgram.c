@@ -20,7 +20,7 @@ static int yygrowstack(void);
 static int yygrowstack();
 #endif
 #define YYPREFIX "yy"
-#line 85 "jamgram.y"
+#line 88 "jamgram.y"
 #include "jam.h"
 
 #include "lists.h"
@@ -79,35 +79,38 @@ static int yygrowstack();
 #define _LBRACKET_t 272
 #define _RBRACKET_t 273
 #define ACTIONS_t 274
-#define BIND_t 275
-#define BREAK_t 276
-#define CASE_t 277
-#define CONTINUE_t 278
-#define DEFAULT_t 279
-#define ELSE_t 280
-#define EXISTING_t 281
-#define FOR_t 282
-#define IF_t 283
-#define IGNORE_t 284
-#define IN_t 285
-#define INCLUDE_t 286
-#define LOCAL_t 287
-#define MAXLINE_t 288
-#define ON_t 289
-#define PIECEMEAL_t 290
-#define QUIETLY_t 291
-#define RETURN_t 292
-#define RULE_t 293
-#define SWITCH_t 294
-#define TOGETHER_t 295
-#define UPDATED_t 296
-#define WHILE_t 297
-#define _LBRACE_t 298
-#define _BAR_t 299
-#define _BARBAR_t 300
-#define _RBRACE_t 301
-#define ARG 302
-#define STRING 303
+#define BATCH_t 275
+#define BIND_t 276
+#define BREAK_t 277
+#define CASE_t 278
+#define CONTINUE_t 279
+#define DEFAULT_t 280
+#define ELSE_t 281
+#define EXISTING_t 282
+#define FOR_t 283
+#define IF_t 284
+#define IGNORE_t 285
+#define IN_t 286
+#define INCLUDE_t 287
+#define LOCAL_t 288
+#define MAXLINE_t 289
+#define ON_t 290
+#define PIECEMEAL_t 291
+#define QUIETLY_t 292
+#define RESPONSE_t 293
+#define RESTAT_t 294
+#define RETURN_t 295
+#define RULE_t 296
+#define SWITCH_t 297
+#define TOGETHER_t 298
+#define UPDATED_t 299
+#define WHILE_t 300
+#define _LBRACE_t 301
+#define _BAR_t 302
+#define _BARBAR_t 303
+#define _RBRACE_t 304
+#define ARG 305
+#define STRING 306
 const short yylhs[] = {                                        -1,
     0,    0,    2,    2,    1,    1,    1,    1,    3,    3,
     3,    3,    3,    3,    3,    3,    3,    3,    3,    3,
@@ -116,7 +119,7 @@ const short yylhs[] = {                                        -1,
     9,    9,    9,    9,    8,    8,   15,   10,   10,   10,
     6,    6,    4,   16,   16,    5,   18,    5,   17,   17,
    17,   11,   11,   19,   19,   19,   19,   19,   19,   19,
-   12,   12,
+   19,   19,   19,   12,   12,
 };
 const short yylen[] = {                                         2,
     0,    1,    0,    1,    1,    2,    4,    6,    3,    3,
@@ -125,8 +128,8 @@ const short yylen[] = {                                         2,
     1,    3,    3,    3,    3,    3,    3,    3,    3,    3,
     3,    3,    2,    3,    0,    2,    4,    0,    3,    1,
     1,    3,    1,    0,    2,    1,    0,    4,    2,    4,
-    4,    0,    2,    1,    1,    1,    1,    1,    1,    2,
-    0,    2,
+    4,    0,    2,    1,    1,    1,    1,    1,    1,    1,
+    1,    1,    2,    0,    2,
 };
 const short yydefred[] = {                                      0,
    57,   62,   54,   54,    0,    0,   54,   54,    0,   54,
@@ -134,146 +137,150 @@ const short yydefred[] = {                                      0,
     0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
     0,    0,    0,    0,    0,    0,    4,    0,    6,   28,
    27,   29,    0,   54,    0,    0,   54,    0,   54,    0,
-   69,   66,    0,   68,   67,   65,   64,    0,   63,   14,
-   55,   15,   54,   43,    0,   54,    0,    0,    0,    0,
-    0,    0,    0,    0,    0,    0,    0,   10,    0,   54,
-   23,   16,    0,    0,    0,    0,    9,   30,    0,   54,
-   11,    0,    0,   59,   58,   70,   54,    0,    0,   44,
-   42,    0,    0,    0,   34,   35,    0,   36,   37,    0,
-    0,    0,    7,    0,    0,    0,    0,    0,    0,    0,
-   54,   52,   12,   54,   54,   72,   24,    0,    0,    0,
-   49,    0,    0,   18,   46,   21,    0,   61,   60,    0,
-    0,    0,    8,   22,    0,   13,   25,   17,   20,   47,
-    0,   26,
+   72,   69,   66,    0,   68,   67,   71,   70,   65,   64,
+    0,   63,   14,   55,   15,   54,   43,    0,   54,    0,
+    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+   10,    0,   54,   23,   16,    0,    0,    0,    0,    9,
+   30,    0,   54,   11,    0,    0,   59,   58,   73,   54,
+    0,    0,   44,   42,    0,    0,    0,   34,   35,    0,
+   36,   37,    0,    0,    0,    7,    0,    0,    0,    0,
+    0,    0,    0,   54,   52,   12,   54,   54,   75,   24,
+    0,    0,    0,   49,    0,    0,   18,   46,   21,    0,
+   61,   60,    0,    0,    0,    8,   22,    0,   13,   25,
+   17,   20,   47,    0,   26,
 };
 const short yydgoto[] = {                                      16,
-   37,   38,   18,   45,   28,   46,   47,  118,   29,   84,
-   21,   98,  140,  151,  119,   23,   50,   20,   59,
+   37,   38,   18,   45,   28,   46,   47,  121,   29,   87,
+   21,  101,  143,  154,  122,   23,   50,   20,   62,
 };
-const short yysindex[] = {                                    -40,
-    0,    0,    0,    0, -295, -233,    0,    0, -240,    0,
- -284,    0, -233,  -40,    0,    0,    0,  -40,   -7, -241,
-   49, -242, -240, -232, -239, -233, -233, -231,  -75, -220,
- -195,   34, -210, -243, -226,  -59,    0, -223,    0,    0,
-    0,    0, -174,    0, -165, -164,    0, -240,    0, -173,
-    0,    0, -199,    0,    0,    0,    0, -166,    0,    0,
-    0,    0,    0,    0, -154,    0, -233, -233, -233, -233,
- -233, -233, -233, -233,  -40, -233, -233,    0,  -40,    0,
-    0,    0, -153, -179, -157,  -40,    0,    0,  -42,    0,
-    0, -144, -185,    0,    0,    0,    0, -171, -170,    0,
-    0,  -54,   94,   94,    0,    0,  -54,    0,    0, -160,
-   88,   88,    0, -140, -243,  -40, -151, -139, -157, -134,
-    0,    0,    0,    0,    0,    0,    0,  -40, -149,  -40,
-    0, -131,  -93,    0,    0,    0,  -85,    0,    0, -121,
- -115,   34,    0,    0,  -40,    0,    0,    0,    0,    0,
- -105,    0,
+const short yysindex[] = {                                     37,
+    0,    0,    0,    0, -272, -251,    0,    0, -242,    0,
+ -266,    0, -251,   37,    0,    0,    0,   37, -171, -258,
+  -37, -223, -242, -217, -233, -251, -251, -231,  -91, -208,
+ -239,   67, -204, -241, -225,  -78,    0, -219,    0,    0,
+    0,    0, -178,    0, -183, -176,    0, -242,    0, -180,
+    0,    0,    0, -206,    0,    0,    0,    0,    0,    0,
+ -172,    0,    0,    0,    0,    0,    0,  -61,    0, -251,
+ -251, -251, -251, -251, -251, -251, -251,   37, -251, -251,
+    0,   37,    0,    0,    0, -158, -194, -170,   37,    0,
+    0,  -34,    0,    0, -155, -249,    0,    0,    0,    0,
+ -190, -189,    0,    0, -226,  116,  116,    0,    0, -226,
+    0,    0, -186,  111,  111,    0, -148, -241,   37, -185,
+ -174, -170, -173,    0,    0,    0,    0,    0,    0,    0,
+   37, -156,   37,    0, -168, -130,    0,    0,    0, -128,
+    0,    0, -152, -166,   67,    0,    0,   37,    0,    0,
+    0,    0,    0, -139,    0,
 };
-const short yyrindex[] = {                                    197,
+const short yyrindex[] = {                                    170,
     0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-    0,    0,    0, -103,    0,    0,    0,    3, -235,    0,
-    0,    0, -110,    0,    0,    0,    0,  -94,    0,    0,
-    0,    0,    0,  -96,    0,    0,    0,    0,    0,    0,
+    0,    0,    0, -118,    0,    0,    0,    3, -227,    0,
+    0,    0, -107,    0,    0,    0,    0, -200,    0,    0,
+    0,    0,    0, -101,    0,    0,    0,    0,    0,    0,
     0,    0,    0,    0, -246,    0,    0,    0,    0,    0,
-    0,    0,    0,    0,    0,    0,    0,  -95,    0,    0,
-    0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-    0,    0,    0,    0, -103,    0,    0,    0,    4,    0,
-    0,    0,  -84,    0,  -79, -103,    0,    0,    0,    0,
     0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-    0, -202, -224, -176,    0,    0,  -81,    0,    0,    0,
- -257, -209,    0,    0,  -96, -103,    0,    0,  -79,    0,
-    0,    0,    0,    0,    0,    0,    0, -103,    1,    4,
+  -99,    0,    0,    0,    0,    0,    0,    0,    0,    0,
+    0,    0,    0,    0,    0,    0,    0, -118,    0,    0,
+    0,    4,    0,    0,    0,  -98,    0, -100, -118,    0,
     0,    0,    0,    0,    0,    0,    0,    0,    0,    0,
-    0,    0,    0,    0, -237,    0,    0,    0,    0,    0,
-    0,    0,
+    0,    0,    0,    0,  -75, -187,  -88,    0,    0,   -9,
+    0,    0,    0, -179, -175,    0,    0, -101, -118,    0,
+    0, -100,    0,    0,    0,    0,    0,    0,    0,    0,
+ -118,    1,    4,    0,    0,    0,    0,    0,    0,    0,
+    0,    0,    0,    0,    0,    0,    0, -273,    0,    0,
+    0,    0,    0,    0,    0,
 };
 const short yygindex[] = {                                      0,
-   26,  -65,  -32,    5,    2,  -43,  131,  108,   66,  113,
+   18,  -54,  -32,    5,    2,  -42,  124,   95,   69,  100,
     0,    0,    0,    0,    0,    0,    0,    0,    0,
 };
-#define YYTABLESIZE 364
-const short yytable[] = {                                      81,
-   19,   19,    5,    3,   40,   94,   25,   22,   24,  110,
-   32,   30,   31,  113,   33,   19,   35,   34,   51,   19,
-  120,   49,   60,   26,   61,   17,   51,   27,   54,   54,
-    1,    1,   62,   19,   38,   38,   54,   38,    1,    3,
-   40,   40,   40,   39,   78,   63,  122,   48,   89,   93,
-  132,   92,   41,   66,   82,   33,   33,   33,   83,   33,
-   15,   15,  141,    3,  143,   33,   54,   99,   15,   79,
-  101,   85,   80,   38,   38,   38,   19,   87,   36,  150,
-   19,  139,   39,   39,  114,   39,    1,   19,   41,   41,
-   41,   64,   65,   88,  125,   33,   33,   33,   90,   95,
-   91,  126,   96,   67,   68,   69,  124,  100,   97,  149,
-  115,   70,   71,   72,   73,   74,   15,   19,  116,  117,
-  123,   39,   39,   39,  130,  137,  127,  128,  138,   19,
-  142,   19,  102,  103,  104,  105,  106,  107,  108,  109,
-  129,  111,  112,   19,   76,   77,   19,   53,   53,   53,
-  133,   53,   53,   53,   53,   53,   53,   53,   53,   53,
-   53,  134,   53,   31,   31,   31,  136,   31,   53,  144,
-  145,   31,   31,   31,   31,   31,   32,   32,   32,  146,
-   32,  147,   67,   68,   69,  148,   32,   53,   53,   53,
-   70,   71,   72,   73,   74,  152,    1,    3,   67,   68,
-   69,   48,   71,   31,   31,   31,   70,   71,   72,   73,
-   74,   70,   71,   50,   73,   74,   32,   32,   32,  121,
-   40,   45,   75,   76,   77,   41,  135,  131,   42,    0,
-    0,    1,    0,    2,    0,    3,   43,    4,   86,   76,
-   77,    5,    6,    0,    0,    7,    8,    0,    9,    0,
-    0,   10,   11,   12,    0,   40,   13,   14,    0,    0,
-   41,   15,    0,   42,    0,    0,    0,    0,    0,    0,
-    0,   43,   19,    0,   19,    0,   19,   19,   19,    5,
-    3,   44,   19,   19,    0,    0,   19,   19,    0,   19,
-    0,    0,   19,   19,   19,    0,    0,   19,   19,    0,
-    0,   19,   19,    5,    3,    1,    0,    2,    0,    3,
-    0,    4,    0,    0,    0,    5,    6,    0,    0,    7,
-    0,    0,    9,    0,    0,   10,   11,   12,    0,   51,
-   13,   14,   52,    0,    0,   15,   53,    0,   54,   55,
-    0,    0,    0,   56,   57,   67,   68,   69,    0,    0,
-   58,   67,    0,   70,   71,   72,   73,   74,    0,   70,
-   71,   72,   73,   74,
+#define YYTABLESIZE 386
+const short yytable[] = {                                      84,
+   19,   19,    5,    3,    3,   26,   97,   22,   24,   27,
+   32,   30,   31,    1,   33,   19,   35,   17,   51,   19,
+    1,   49,    1,  113,   64,   82,   51,  116,   83,    1,
+    3,   48,   25,   19,  123,   39,   54,   54,   34,   73,
+   74,   63,   76,   77,   54,  127,   15,   65,   92,   96,
+  125,   95,   66,   15,   69,   15,   81,   31,   31,   31,
+   85,   31,   15,   86,  135,   31,   31,   31,   31,   31,
+  102,   38,   38,  104,   38,   88,  144,   54,  146,   19,
+   93,   36,   40,   19,   90,  142,   41,  117,   94,   91,
+   19,   40,   98,  153,   67,   68,   41,  128,   99,   42,
+   31,   31,   31,  100,  129,  118,  119,  120,   43,  126,
+  130,  131,  152,   38,   38,   38,  133,  132,   44,  136,
+   19,   40,   40,   40,  145,   41,   41,   41,  140,  137,
+  139,  141,   19,  148,   19,  147,  149,  151,  105,  106,
+  107,  108,  109,  110,  111,  112,   19,  114,  115,   19,
+   53,   53,   53,  150,   53,   53,   53,   53,   53,   53,
+   53,   53,   53,   53,  155,   53,   70,   71,   72,    1,
+   39,   39,   53,   39,   73,   74,   75,   76,   77,   70,
+   71,   72,   33,   33,   33,    3,   33,   73,   74,   75,
+   76,   77,   33,   53,   53,   53,   70,   71,   72,   48,
+  103,   74,   50,   45,   73,   74,   75,   76,   77,   78,
+   79,   80,   39,   39,   39,  124,  138,  134,    0,    0,
+    0,    0,   89,   79,   80,   33,   33,   33,   40,    0,
+    0,    0,    0,   41,    0,    0,   42,   51,    0,    0,
+   79,   80,    0,    0,   52,   43,    0,   53,   32,   32,
+   32,   54,   32,   55,   56,   57,   58,    0,   32,    0,
+   59,   60,    0,    0,    0,    0,    0,   61,    0,    0,
+    0,    0,   19,    0,   19,    0,    0,   19,   19,   19,
+    5,    3,    0,   19,   19,    0,    0,   19,   19,    0,
+   19,   32,   32,   32,    0,   19,   19,   19,    0,    0,
+   19,   19,    0,    0,   19,   19,    5,    3,    1,    0,
+    2,    0,    0,    3,    0,    4,    0,    0,    0,    5,
+    6,    0,    0,    7,    8,    0,    9,    0,    0,    0,
+    0,   10,   11,   12,    0,    0,   13,   14,    1,    0,
+    2,   15,    0,    3,    0,    4,    0,    0,    0,    5,
+    6,    0,    0,    7,    0,    0,    9,    0,    0,    0,
+    0,   10,   11,   12,    0,    0,   13,   14,   70,   71,
+   72,   15,    0,   70,    0,    0,   73,   74,   75,   76,
+   77,   73,   74,   75,   76,   77,
 };
 const short yycheck[] = {                                      32,
-    0,    0,    0,    0,  262,   49,  302,    3,    4,   75,
-    9,    7,    8,   79,   10,   14,   12,  302,  265,   18,
-   86,   20,  265,  257,   23,    0,  273,  261,  264,  265,
-  272,  272,  265,   32,  259,  260,  272,  262,  272,  277,
-  298,  299,  300,   18,  265,  285,   90,  289,   44,   48,
-  116,   47,  262,  285,  265,  258,  259,  260,  302,  262,
-  302,  302,  128,  301,  130,  268,  302,   63,  302,  265,
-   66,  298,  268,  298,  299,  300,   75,  301,   13,  145,
-   79,  125,  259,  260,   80,  262,  272,   86,  298,  299,
-  300,   26,   27,  268,   93,  298,  299,  300,  264,  273,
-  265,   97,  302,  258,  259,  260,  292,  262,  275,  142,
-  264,  266,  267,  268,  269,  270,  302,  116,  298,  277,
-  265,  298,  299,  300,  265,  121,  298,  298,  124,  128,
-  280,  130,   67,   68,   69,   70,   71,   72,   73,   74,
-  301,   76,   77,  142,  299,  300,  145,  258,  259,  260,
-  302,  262,  263,  264,  265,  266,  267,  268,  269,  270,
-  271,  301,  273,  258,  259,  260,  301,  262,  279,  301,
-  264,  266,  267,  268,  269,  270,  258,  259,  260,  265,
-  262,  303,  258,  259,  260,  301,  268,  298,  299,  300,
-  266,  267,  268,  269,  270,  301,    0,  301,  258,  259,
-  260,  298,  298,  298,  299,  300,  266,  267,  268,  269,
-  270,  266,  267,  298,  269,  270,  298,  299,  300,   89,
-  263,  301,  298,  299,  300,  268,  119,  115,  271,   -1,
-   -1,  272,   -1,  274,   -1,  276,  279,  278,  298,  299,
-  300,  282,  283,   -1,   -1,  286,  287,   -1,  289,   -1,
-   -1,  292,  293,  294,   -1,  263,  297,  298,   -1,   -1,
-  268,  302,   -1,  271,   -1,   -1,   -1,   -1,   -1,   -1,
-   -1,  279,  272,   -1,  274,   -1,  276,  277,  278,  277,
-  277,  289,  282,  283,   -1,   -1,  286,  287,   -1,  289,
-   -1,   -1,  292,  293,  294,   -1,   -1,  297,  298,   -1,
-   -1,  301,  302,  301,  301,  272,   -1,  274,   -1,  276,
-   -1,  278,   -1,   -1,   -1,  282,  283,   -1,   -1,  286,
-   -1,   -1,  289,   -1,   -1,  292,  293,  294,   -1,  281,
-  297,  298,  284,   -1,   -1,  302,  288,   -1,  290,  291,
-   -1,   -1,   -1,  295,  296,  258,  259,  260,   -1,   -1,
-  302,  258,   -1,  266,  267,  268,  269,  270,   -1,  266,
-  267,  268,  269,  270,
+    0,    0,    0,    0,  278,  257,   49,    3,    4,  261,
+    9,    7,    8,  272,   10,   14,   12,    0,  265,   18,
+  272,   20,  272,   78,   23,  265,  273,   82,  268,  272,
+  304,  290,  305,   32,   89,   18,  264,  265,  305,  266,
+  267,  265,  269,  270,  272,  295,  305,  265,   44,   48,
+   93,   47,  286,  305,  286,  305,  265,  258,  259,  260,
+  265,  262,  305,  305,  119,  266,  267,  268,  269,  270,
+   66,  259,  260,   69,  262,  301,  131,  305,  133,   78,
+  264,   13,  262,   82,  304,  128,  262,   83,  265,  268,
+   89,  263,  273,  148,   26,   27,  268,   96,  305,  271,
+  301,  302,  303,  276,  100,  264,  301,  278,  280,  265,
+  301,  301,  145,  301,  302,  303,  265,  304,  290,  305,
+  119,  301,  302,  303,  281,  301,  302,  303,  124,  304,
+  304,  127,  131,  264,  133,  304,  265,  304,   70,   71,
+   72,   73,   74,   75,   76,   77,  145,   79,   80,  148,
+  258,  259,  260,  306,  262,  263,  264,  265,  266,  267,
+  268,  269,  270,  271,  304,  273,  258,  259,  260,    0,
+  259,  260,  280,  262,  266,  267,  268,  269,  270,  258,
+  259,  260,  258,  259,  260,  304,  262,  266,  267,  268,
+  269,  270,  268,  301,  302,  303,  258,  259,  260,  301,
+  262,  301,  301,  304,  266,  267,  268,  269,  270,  301,
+  302,  303,  301,  302,  303,   92,  122,  118,   -1,   -1,
+   -1,   -1,  301,  302,  303,  301,  302,  303,  263,   -1,
+   -1,   -1,   -1,  268,   -1,   -1,  271,  275,   -1,   -1,
+  302,  303,   -1,   -1,  282,  280,   -1,  285,  258,  259,
+  260,  289,  262,  291,  292,  293,  294,   -1,  268,   -1,
+  298,  299,   -1,   -1,   -1,   -1,   -1,  305,   -1,   -1,
+   -1,   -1,  272,   -1,  274,   -1,   -1,  277,  278,  279,
+  278,  278,   -1,  283,  284,   -1,   -1,  287,  288,   -1,
+  290,  301,  302,  303,   -1,  295,  296,  297,   -1,   -1,
+  300,  301,   -1,   -1,  304,  305,  304,  304,  272,   -1,
+  274,   -1,   -1,  277,   -1,  279,   -1,   -1,   -1,  283,
+  284,   -1,   -1,  287,  288,   -1,  290,   -1,   -1,   -1,
+   -1,  295,  296,  297,   -1,   -1,  300,  301,  272,   -1,
+  274,  305,   -1,  277,   -1,  279,   -1,   -1,   -1,  283,
+  284,   -1,   -1,  287,   -1,   -1,  290,   -1,   -1,   -1,
+   -1,  295,  296,  297,   -1,   -1,  300,  301,  258,  259,
+  260,  305,   -1,  258,   -1,   -1,  266,  267,  268,  269,
+  270,  266,  267,  268,  269,  270,
 };
 #define YYFINAL 16
 #ifndef YYDEBUG
 #define YYDEBUG 0
 #endif
-#define YYMAXTOKEN 303
+#define YYMAXTOKEN 306
 #if YYDEBUG
 const char * const yyname[] = {
 "end-of-file",0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
@@ -286,11 +293,11 @@ const char * const yyname[] = {
 "_AMPER_t","_AMPERAMPER_t","_LPAREN_t","_RPAREN_t","_PLUS_EQUALS_t","_COLON_t",
 "_SEMIC_t","_LANGLE_t","_LANGLE_EQUALS_t","_EQUALS_t","_RANGLE_t",
 "_RANGLE_EQUALS_t","_QUESTION_EQUALS_t","_LBRACKET_t","_RBRACKET_t","ACTIONS_t",
-"BIND_t","BREAK_t","CASE_t","CONTINUE_t","DEFAULT_t","ELSE_t","EXISTING_t",
-"FOR_t","IF_t","IGNORE_t","IN_t","INCLUDE_t","LOCAL_t","MAXLINE_t","ON_t",
-"PIECEMEAL_t","QUIETLY_t","RETURN_t","RULE_t","SWITCH_t","TOGETHER_t",
-"UPDATED_t","WHILE_t","_LBRACE_t","_BAR_t","_BARBAR_t","_RBRACE_t","ARG",
-"STRING",
+"BATCH_t","BIND_t","BREAK_t","CASE_t","CONTINUE_t","DEFAULT_t","ELSE_t",
+"EXISTING_t","FOR_t","IF_t","IGNORE_t","IN_t","INCLUDE_t","LOCAL_t","MAXLINE_t",
+"ON_t","PIECEMEAL_t","QUIETLY_t","RESPONSE_t","RESTAT_t","RETURN_t","RULE_t",
+"SWITCH_t","TOGETHER_t","UPDATED_t","WHILE_t","_LBRACE_t","_BAR_t","_BARBAR_t",
+"_RBRACE_t","ARG","STRING",
 };
 const char * const yyrule[] = {
 "$accept : run",
@@ -363,6 +370,9 @@ const char * const yyrule[] = {
 "eflag : QUIETLY_t",
 "eflag : PIECEMEAL_t",
 "eflag : EXISTING_t",
+"eflag : RESTAT_t",
+"eflag : RESPONSE_t",
+"eflag : BATCH_t",
 "eflag : MAXLINE_t ARG",
 "bindlist :",
 "bindlist : BIND_t list",
@@ -593,290 +603,302 @@ yyreduce:
     switch (yyn)
     {
 case 2:
-#line 130 "jamgram.y"
+#line 133 "jamgram.y"
 { parse_save( yyvsp[0].parse ); }
 break;
 case 3:
-#line 141 "jamgram.y"
+#line 144 "jamgram.y"
 { yyval.parse = pnull(); }
 break;
 case 4:
-#line 143 "jamgram.y"
+#line 146 "jamgram.y"
 { yyval.parse = yyvsp[0].parse; }
 break;
 case 5:
-#line 147 "jamgram.y"
+#line 150 "jamgram.y"
 { yyval.parse = yyvsp[0].parse; }
 break;
 case 6:
-#line 149 "jamgram.y"
+#line 152 "jamgram.y"
 { yyval.parse = prules( yyvsp[-1].parse, yyvsp[0].parse ); }
 break;
 case 7:
-#line 151 "jamgram.y"
+#line 154 "jamgram.y"
 { yyval.parse = plocal( yyvsp[-2].parse, pnull(), yyvsp[0].parse ); }
 break;
 case 8:
-#line 153 "jamgram.y"
+#line 156 "jamgram.y"
 { yyval.parse = plocal( yyvsp[-4].parse, yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 9:
-#line 157 "jamgram.y"
+#line 160 "jamgram.y"
 { yyval.parse = yyvsp[-1].parse; }
 break;
 case 10:
-#line 159 "jamgram.y"
+#line 162 "jamgram.y"
 { yyval.parse = pincl( yyvsp[-1].parse ); }
 break;
 case 11:
-#line 161 "jamgram.y"
+#line 164 "jamgram.y"
 { yyval.parse = prule( yyvsp[-2].parse, yyvsp[-1].parse ); }
 break;
 case 12:
-#line 163 "jamgram.y"
+#line 166 "jamgram.y"
 { yyval.parse = pset( yyvsp[-3].parse, yyvsp[-1].parse, yyvsp[-2].number ); }
 break;
 case 13:
-#line 165 "jamgram.y"
+#line 168 "jamgram.y"
 { yyval.parse = pset1( yyvsp[-5].parse, yyvsp[-3].parse, yyvsp[-1].parse, yyvsp[-2].number ); }
 break;
 case 14:
-#line 167 "jamgram.y"
+#line 170 "jamgram.y"
 { yyval.parse = pbreak( yyvsp[-1].parse, JMP_BREAK ); }
 break;
 case 15:
-#line 169 "jamgram.y"
+#line 172 "jamgram.y"
 { yyval.parse = pbreak( yyvsp[-1].parse, JMP_CONTINUE ); }
 break;
 case 16:
-#line 171 "jamgram.y"
+#line 174 "jamgram.y"
 { yyval.parse = pbreak( yyvsp[-1].parse, JMP_RETURN ); }
 break;
 case 17:
-#line 173 "jamgram.y"
+#line 176 "jamgram.y"
 { yyval.parse = pfor( yyvsp[-5].string, yyvsp[-3].parse, yyvsp[-1].parse ); }
 break;
 case 18:
-#line 175 "jamgram.y"
+#line 178 "jamgram.y"
 { yyval.parse = pswitch( yyvsp[-3].parse, yyvsp[-1].parse ); }
 break;
 case 19:
-#line 177 "jamgram.y"
+#line 180 "jamgram.y"
 { yyval.parse = pif( yyvsp[-3].parse, yyvsp[-1].parse, pnull() ); }
 break;
 case 20:
-#line 179 "jamgram.y"
+#line 182 "jamgram.y"
 { yyval.parse = pif( yyvsp[-5].parse, yyvsp[-3].parse, yyvsp[0].parse ); }
 break;
 case 21:
-#line 181 "jamgram.y"
+#line 184 "jamgram.y"
 { yyval.parse = pwhile( yyvsp[-3].parse, yyvsp[-1].parse ); }
 break;
 case 22:
-#line 183 "jamgram.y"
+#line 186 "jamgram.y"
 { yyval.parse = psetc( yyvsp[-4].string, yyvsp[-3].parse, yyvsp[-1].parse ); }
 break;
 case 23:
-#line 185 "jamgram.y"
+#line 188 "jamgram.y"
 { yyval.parse = pon( yyvsp[-1].parse, yyvsp[0].parse ); }
 break;
 case 24:
-#line 187 "jamgram.y"
+#line 190 "jamgram.y"
 { yymode( SCAN_STRING ); }
 break;
 case 25:
-#line 189 "jamgram.y"
+#line 192 "jamgram.y"
 { yymode( SCAN_NORMAL ); }
 break;
 case 26:
-#line 191 "jamgram.y"
+#line 194 "jamgram.y"
 { yyval.parse = psete( yyvsp[-6].string,yyvsp[-5].parse,yyvsp[-2].string,yyvsp[-7].number ); }
 break;
 case 27:
-#line 199 "jamgram.y"
+#line 202 "jamgram.y"
 { yyval.number = VAR_SET; }
 break;
 case 28:
-#line 201 "jamgram.y"
+#line 204 "jamgram.y"
 { yyval.number = VAR_APPEND; }
 break;
 case 29:
-#line 203 "jamgram.y"
+#line 206 "jamgram.y"
 { yyval.number = VAR_DEFAULT; }
 break;
 case 30:
-#line 205 "jamgram.y"
+#line 208 "jamgram.y"
 { yyval.number = VAR_DEFAULT; }
 break;
 case 31:
-#line 213 "jamgram.y"
+#line 216 "jamgram.y"
 { yyval.parse = peval( EXPR_EXISTS, yyvsp[0].parse, pnull() ); }
 break;
 case 32:
-#line 215 "jamgram.y"
+#line 218 "jamgram.y"
 { yyval.parse = peval( EXPR_EQUALS, yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 33:
-#line 217 "jamgram.y"
+#line 220 "jamgram.y"
 { yyval.parse = peval( EXPR_NOTEQ, yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 34:
-#line 219 "jamgram.y"
+#line 222 "jamgram.y"
 { yyval.parse = peval( EXPR_LESS, yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 35:
-#line 221 "jamgram.y"
+#line 224 "jamgram.y"
 { yyval.parse = peval( EXPR_LESSEQ, yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 36:
-#line 223 "jamgram.y"
+#line 226 "jamgram.y"
 { yyval.parse = peval( EXPR_MORE, yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 37:
-#line 225 "jamgram.y"
+#line 228 "jamgram.y"
 { yyval.parse = peval( EXPR_MOREEQ, yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 38:
-#line 227 "jamgram.y"
+#line 230 "jamgram.y"
 { yyval.parse = peval( EXPR_AND, yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 39:
-#line 229 "jamgram.y"
+#line 232 "jamgram.y"
 { yyval.parse = peval( EXPR_AND, yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 40:
-#line 231 "jamgram.y"
+#line 234 "jamgram.y"
 { yyval.parse = peval( EXPR_OR, yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 41:
-#line 233 "jamgram.y"
+#line 236 "jamgram.y"
 { yyval.parse = peval( EXPR_OR, yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 42:
-#line 235 "jamgram.y"
+#line 238 "jamgram.y"
 { yyval.parse = peval( EXPR_IN, yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 43:
-#line 237 "jamgram.y"
+#line 240 "jamgram.y"
 { yyval.parse = peval( EXPR_NOT, yyvsp[0].parse, pnull() ); }
 break;
 case 44:
-#line 239 "jamgram.y"
+#line 242 "jamgram.y"
 { yyval.parse = yyvsp[-1].parse; }
 break;
 case 45:
-#line 249 "jamgram.y"
+#line 252 "jamgram.y"
 { yyval.parse = P0; }
 break;
 case 46:
-#line 251 "jamgram.y"
+#line 254 "jamgram.y"
 { yyval.parse = pnode( yyvsp[-1].parse, yyvsp[0].parse ); }
 break;
 case 47:
-#line 255 "jamgram.y"
+#line 258 "jamgram.y"
 { yyval.parse = psnode( yyvsp[-2].string, yyvsp[0].parse ); }
 break;
 case 48:
-#line 264 "jamgram.y"
+#line 267 "jamgram.y"
 { yyval.parse = P0; }
 break;
 case 49:
-#line 266 "jamgram.y"
+#line 269 "jamgram.y"
 { yyval.parse = psnode( yyvsp[-2].string, yyvsp[0].parse ); }
 break;
 case 50:
-#line 268 "jamgram.y"
+#line 271 "jamgram.y"
 { yyval.parse = psnode( yyvsp[0].string, P0 ); }
 break;
 case 51:
-#line 277 "jamgram.y"
+#line 280 "jamgram.y"
 { yyval.parse = pnode( P0, yyvsp[0].parse ); }
 break;
 case 52:
-#line 279 "jamgram.y"
+#line 282 "jamgram.y"
 { yyval.parse = pnode( yyvsp[0].parse, yyvsp[-2].parse ); }
 break;
 case 53:
-#line 289 "jamgram.y"
+#line 292 "jamgram.y"
 { yyval.parse = yyvsp[0].parse; yymode( SCAN_NORMAL ); }
 break;
 case 54:
-#line 293 "jamgram.y"
+#line 296 "jamgram.y"
 { yyval.parse = pnull(); yymode( SCAN_PUNCT ); }
 break;
 case 55:
-#line 295 "jamgram.y"
+#line 298 "jamgram.y"
 { yyval.parse = pappend( yyvsp[-1].parse, yyvsp[0].parse ); }
 break;
 case 56:
-#line 299 "jamgram.y"
+#line 302 "jamgram.y"
 { yyval.parse = plist( yyvsp[0].string ); }
 break;
 case 57:
-#line 300 "jamgram.y"
+#line 303 "jamgram.y"
 { yymode( SCAN_NORMAL ); }
 break;
 case 58:
-#line 301 "jamgram.y"
+#line 304 "jamgram.y"
 { yyval.parse = yyvsp[-1].parse; }
 break;
 case 59:
-#line 310 "jamgram.y"
+#line 313 "jamgram.y"
 { yyval.parse = prule( yyvsp[-1].parse, yyvsp[0].parse ); }
 break;
 case 60:
-#line 312 "jamgram.y"
+#line 315 "jamgram.y"
 { yyval.parse = pon( yyvsp[-2].parse, prule( yyvsp[-1].parse, yyvsp[0].parse ) ); }
 break;
 case 61:
-#line 314 "jamgram.y"
+#line 317 "jamgram.y"
 { yyval.parse = pon( yyvsp[-2].parse, yyvsp[0].parse ); }
 break;
 case 62:
-#line 323 "jamgram.y"
+#line 326 "jamgram.y"
 { yyval.number = 0; }
 break;
 case 63:
-#line 325 "jamgram.y"
+#line 328 "jamgram.y"
 { yyval.number = yyvsp[-1].number | yyvsp[0].number; }
 break;
 case 64:
-#line 329 "jamgram.y"
+#line 332 "jamgram.y"
 { yyval.number = RULE_UPDATED; }
 break;
 case 65:
-#line 331 "jamgram.y"
+#line 334 "jamgram.y"
 { yyval.number = RULE_TOGETHER; }
 break;
 case 66:
-#line 333 "jamgram.y"
+#line 336 "jamgram.y"
 { yyval.number = RULE_IGNORE; }
 break;
 case 67:
-#line 335 "jamgram.y"
+#line 338 "jamgram.y"
 { yyval.number = RULE_QUIETLY; }
 break;
 case 68:
-#line 337 "jamgram.y"
+#line 340 "jamgram.y"
 { yyval.number = RULE_PIECEMEAL; }
 break;
 case 69:
-#line 339 "jamgram.y"
+#line 342 "jamgram.y"
 { yyval.number = RULE_EXISTING; }
 break;
 case 70:
-#line 341 "jamgram.y"
-{ yyval.number = atoi( yyvsp[0].string ) * RULE_MAXLINE; }
+#line 344 "jamgram.y"
+{ yyval.number = RULE_RESTAT; }
 break;
 case 71:
+#line 346 "jamgram.y"
+{ yyval.number = RULE_RESPONSE; }
+break;
+case 72:
+#line 348 "jamgram.y"
+{ yyval.number = RULE_BATCH; }
+break;
+case 73:
 #line 350 "jamgram.y"
+{ yyval.number = atoi( yyvsp[0].string ) * RULE_MAXLINE; }
+break;
+case 74:
+#line 359 "jamgram.y"
 { yyval.parse = pnull(); }
 break;
-case 72:
-#line 352 "jamgram.y"
+case 75:
+#line 361 "jamgram.y"
 { yyval.parse = yyvsp[0].parse; }
 break;
-#line 880 "y.tab.c"
+#line 902 "y.tab.c"
     }
     yyssp -= yym;
     yystate = *yyssp;
@@ -16,6 +16,7 @@
 %token _LBRACKET_t
 %token _RBRACKET_t
 %token ACTIONS_t
+%token BATCH_t
 %token BIND_t
 %token BREAK_t
 %token CASE_t
@@ -33,6 +34,8 @@
 %token ON_t
 %token PIECEMEAL_t
 %token QUIETLY_t
+%token RESPONSE_t
+%token RESTAT_t
 %token RETURN_t
 %token RULE_t
 %token SWITCH_t
@@ -337,6 +340,12 @@ eflag	: UPDATED_t
 		{ $$.number = RULE_PIECEMEAL; }
 	| EXISTING_t
 		{ $$.number = RULE_EXISTING; }
+	| RESTAT_t
+		{ $$.number = RULE_RESTAT; }
+	| RESPONSE_t
+		{ $$.number = RULE_RESPONSE; }
+	| BATCH_t
+		{ $$.number = RULE_BATCH; }
 	| MAXLINE_t ARG
 		{ $$.number = atoi( $2.string ) * RULE_MAXLINE; }
 	;
@@ -292,6 +292,12 @@ eflag	: `updated`
 		{ $$.number = RULE_PIECEMEAL; }
 	| `existing`
 		{ $$.number = RULE_EXISTING; }
+	| `restat`
+		{ $$.number = RULE_RESTAT; }
+	| `response`
+		{ $$.number = RULE_RESPONSE; }
+	| `batch`
+		{ $$.number = RULE_BATCH; }
 	| `maxline` ARG
 		{ $$.number = atoi( $2.string ) * RULE_MAXLINE; }
 	;
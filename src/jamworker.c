@@ -0,0 +1,497 @@
+/*
+ * Copyright 1993-2002 Christopher Seiwald and Perforce Software, Inc.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * jamworker.c - run commands for jam, as one of its $(JAMWORKERS)
+ *
+ * Usage: jamworker unix:/path | [host:]port
+ *
+ * Listens on the Unix socket or TCP port (on the loopback address,
+ * unless a host is given) and serves each connection in a process of
+ * its own: for each request jam sends, it runs the command with /bin/sh
+ * -c in jam's cwd and environment, and sends back the exit code, what
+ * the command wrote (and which inputs were missing, if it failed), and
+ * the output files.  See remote.c for the protocol.
+ *
+ * There's no authentication: anyone who can connect can run commands
+ * as whoever runs jamworker.  Put Unix sockets in a private directory,
+ * and don't listen on a TCP port others can reach.
+ */
+
+# include <stdio.h>
+# include <stdlib.h>
+# include <string.h>
+# include <errno.h>
+# include <signal.h>
+# include <unistd.h>
+# include <fcntl.h>
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/wait.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <netdb.h>
+
+typedef struct {
+	char	*buf;
+	long	len;
+	long	size;
+} BUF ;
+
+static int listento( const char *where );
+static void serve( int fd );
+static int run( const char *cmd, char **env, BUF *out );
+static void put( BUF *b, const char *s, long len );
+static void putnum( BUF *b, long n );
+static void putstr( BUF *b, const char *s, long len );
+static void putfile( BUF *b, const char *name );
+static int getnum( FILE *f, long *n );
+static char *getstr( FILE *f );
+static char **getlist( FILE *f, long *n );
+static void freelist( char **l, long n );
+
+int
+main( int argc, char **argv )
+{
+	int fd, conn;
+
+	if( argc != 2 )
+	{
+	    fprintf( stderr, "usage: %s unix:/path | [host:]port\n", argv[0] );
+	    return 1;
+	}
+
+	if( ( fd = listento( argv[1] ) ) < 0 )
+	    return 1;
+
+	/* Connections are served by children we needn't wait for. */
+
+	signal( SIGCHLD, SIG_IGN );
+	signal( SIGPIPE, SIG_IGN );
+
+	for( ;; )
+	{
+	    if( ( conn = accept( fd, 0, 0 ) ) < 0 )
+	    {
+		if( errno == EINTR || errno == ECONNABORTED )
+		    continue;
+		perror( "accept" );
+		return 1;
+	    }
+
+	    switch( fork() )
+	    {
+	    case -1:
+		perror( "fork" );
+		break;
+
+	    case 0:
+		close( fd );
+		signal( SIGCHLD, SIG_DFL );
+		serve( conn );
+		_exit( 0 );
+	    }
+
+	    close( conn );
+	}
+}
+
+/*
+ * listento() - make the listening socket
+ */
+
+static int
+listento( const char *where )
+{
+	int fd = -1;
+	int on = 1;
+
+	if( !strncmp( where, "unix:", 5 ) )
+	{
+	    struct sockaddr_un addr;
+
+	    if( strlen( where + 5 ) >= sizeof( addr.sun_path ) )
+	    {
+		fprintf( stderr, "jamworker: %s: path too long\n", where );
+		return -1;
+	    }
+
+	    memset( (char *)&addr, '\0', sizeof( addr ) );
+	    addr.sun_family = AF_UNIX;
+	    strcpy( addr.sun_path, where + 5 );
+	    unlink( addr.sun_path );
+
+	    if( ( fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ) < 0 ||
+		bind( fd, (struct sockaddr *)&addr, sizeof( addr ) ) < 0 )
+	    {
+		perror( where );
+		return -1;
+	    }
+	}
+	else
+	{
+	    struct addrinfo hints, *res, *ai;
+	    char host[ 1024 ];
+	    const char *port = strrchr( where, ':' );
+	    int e;
+
+	    if( port && port - where < sizeof( host ) )
+	    {
+		memcpy( host, where, port - where );
+		host[ port++ - where ] = 0;
+	    }
+	    else
+	    {
+		strcpy( host, "localhost" );
+		port = where;
+	    }
+
+	    memset( (char *)&hints, '\0', sizeof( hints ) );
+	    hints.ai_family = AF_UNSPEC;
+	    hints.ai_socktype = SOCK_STREAM;
+	    hints.ai_flags = AI_PASSIVE;
+
+	    if( ( e = getaddrinfo( host, port, &hints, &res ) ) )
+	    {
+		fprintf( stderr, "jamworker: %s: %s\n", where, gai_strerror( e ) );
+		return -1;
+	    }
+
+	    for( ai = res; ai && fd < 0; ai = ai->ai_next )
+		if( ( fd = socket( ai->ai_family, ai->ai_socktype,
+			ai->ai_protocol ) ) >= 0 &&
+		    ( setsockopt( fd, SOL_SOCKET, SO_REUSEADDR,
+			(char *)&on, sizeof( on ) ),
+		      bind( fd, ai->ai_addr, ai->ai_addrlen ) < 0 ) )
+			close( fd ), fd = -1;
+
+	    freeaddrinfo( res );
+
+	    if( fd < 0 )
+	    {
+		perror( where );
+		return -1;
+	    }
+	}
+
+	if( listen( fd, 16 ) < 0 )
+	{
+	    perror( "listen" );
+	    return -1;
+	}
+
+	return fd;
+}
+
+/*
+ * serve() - run the commands sent on one connection
+ */
+
+static void
+serve( int fd )
+{
+	FILE	*in = fdopen( fd, "r" );
+	char	line[ 32 ];
+	char	*cwd, *cmd, **env, **ins, **outs;
+	long	nenv, nins, nouts, i, n;
+	int	code;
+	BUF	out[1], resp[1];
+	struct stat st;
+
+	memset( (char *)out, '\0', sizeof( *out ) );
+	memset( (char *)resp, '\0', sizeof( *resp ) );
+
+	/* Commands shouldn't hold the connection open. */
+
+	fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+	while( fgets( line, sizeof( line ), in ) )
+	{
+	    if( strcmp( line, "jamworker 1\n" ) )
+	    {
+		fprintf( stderr, "jamworker: bad request\n" );
+		return;
+	    }
+
+	    if( !( cwd = getstr( in ) ) )
+		return;
+
+	    if( !( env = getlist( in, &nenv ) ) ||
+		!( ins = getlist( in, &nins ) ) ||
+		!( outs = getlist( in, &nouts ) ) ||
+		!( cmd = getstr( in ) ) )
+		    return;
+
+	    /* Run it, if we're in the right place. */
+
+	    out->len = resp->len = 0;
+	    code = 1;
+
+	    if( chdir( cwd ) < 0 )
+	    {
+		put( out, "jamworker: can't chdir to ", 26 );
+		put( out, cwd, strlen( cwd ) );
+		put( out, "\n", 1 );
+	    }
+	    else if( ( code = run( cmd, env, out ) ) )
+	    {
+		/* $(>) may name things that aren't files, so missing */
+		/* inputs are only mentioned if the command failed. */
+
+		for( i = 0; i < nins; i++ )
+		    if( stat( ins[i], &st ) < 0 )
+		{
+		    put( out, "jamworker: can't find ", 22 );
+		    put( out, ins[i], strlen( ins[i] ) );
+		    put( out, "\n", 1 );
+		}
+	    }
+
+	    /* Code, output, and outputs. */
+
+	    putnum( resp, code );
+	    putstr( resp, out->buf, out->len );
+	    putnum( resp, nouts );
+
+	    for( i = 0; i < nouts; i++ )
+		putfile( resp, outs[i] );
+
+	    for( i = 0; i < resp->len; i += n )
+		if( ( n = write( fd, resp->buf + i, resp->len - i ) ) <= 0 )
+		    return;
+
+	    free( cwd );
+	    free( cmd );
+	    freelist( env, nenv );
+	    freelist( ins, nins );
+	    freelist( outs, nouts );
+	}
+}
+
+/*
+ * run() - run a command, collecting its output
+ *
+ * Returns its exit code, or -1 if it was killed.
+ */
+
+static int
+run(
+	const char	*cmd,
+	char		**env,
+	BUF		*out )
+{
+	int	p[2];
+	int	pid, status, w;
+	char	buf[ 4096 ];
+
+	if( pipe( p ) < 0 )
+	{
+	    perror( "pipe" );
+	    return -1;
+	}
+
+	if( ( pid = fork() ) == 0 )
+	{
+	    close( p[0] );
+	    dup2( p[1], 1 );
+	    dup2( p[1], 2 );
+	    close( p[1] );
+
+	    /* The command shouldn't inherit our ignored signals. */
+
+	    signal( SIGPIPE, SIG_DFL );
+	    signal( SIGCHLD, SIG_DFL );
+	    execle( "/bin/sh", "sh", "-c", cmd, (char *)0, env );
+	    _exit( 127 );
+	}
+
+	close( p[1] );
+
+	if( pid < 0 )
+	{
+	    close( p[0] );
+	    perror( "fork" );
+	    return -1;
+	}
+
+	while( ( w = read( p[0], buf, sizeof( buf ) ) ) > 0 ||
+		( w < 0 && errno == EINTR ) )
+	    if( w > 0 )
+		put( out, buf, w );
+
+	close( p[0] );
+
+	while( waitpid( pid, &status, 0 ) < 0 )
+	    if( errno != EINTR )
+		return -1;
+
+	return WIFEXITED( status ) ? WEXITSTATUS( status ) : -1;
+}
+
+/*
+ * put() - append bytes to a buffer
+ */
+
+static void
+put(
+	BUF		*b,
+	const char	*s,
+	long		len )
+{
+	if( b->len + len > b->size )
+	{
+	    b->size = ( b->len + len ) * 2 + 4096;
+	    b->buf = (char *)realloc( b->buf, b->size );
+	}
+
+	memcpy( b->buf + b->len, s, len );
+	b->len += len;
+}
+
+/*
+ * putnum() - append a number to a response
+ */
+
+static void
+putnum(
+	BUF	*b,
+	long	n )
+{
+	char buf[ 32 ];
+
+	put( b, buf, sprintf( buf, "%ld\n", n ) );
+}
+
+/*
+ * putstr() - append a string to a response
+ */
+
+static void
+putstr(
+	BUF		*b,
+	const char	*s,
+	long		len )
+{
+	putnum( b, len );
+	put( b, s, len );
+}
+
+/*
+ * putfile() - append an output file's name, mode, size and contents
+ */
+
+static void
+putfile(
+	BUF		*b,
+	const char	*name )
+{
+	struct stat	st;
+	FILE		*f;
+	char		*buf;
+	long		size = -1;
+
+	putstr( b, name, strlen( name ) );
+
+	if( ( f = fopen( name, "rb" ) ) && !fstat( fileno( f ), &st ) &&
+	    S_ISREG( st.st_mode ) && ( buf = (char *)malloc( st.st_size + 1 ) ) )
+	{
+	    if( fread( buf, 1, st.st_size, f ) == st.st_size )
+		size = st.st_size;
+	    else
+		free( buf );
+	}
+
+	if( f )
+	    fclose( f );
+
+	putnum( b, size < 0 ? 0 : st.st_mode & 07777 );
+	putnum( b, size );
+
+	if( size >= 0 )
+	{
+	    put( b, buf, size );
+	    free( buf );
+	}
+}
+
+/*
+ * getnum() - read a number from a request
+ */
+
+static int
+getnum(
+	FILE	*f,
+	long	*n )
+{
+	char line[ 32 ];
+
+	return fgets( line, sizeof( line ), f ) && sscanf( line, "%ld", n ) == 1;
+}
+
+/*
+ * getstr() - read a string from a request, into malloc'ed memory
+ */
+
+static char *
+getstr( FILE *f )
+{
+	long	len;
+	char	*s;
+
+	if( !getnum( f, &len ) || len < 0 || !( s = (char *)malloc( len + 1 ) ) )
+	    return 0;
+
+	if( fread( s, 1, len, f ) != len )
+	{
+	    free( s );
+	    return 0;
+	}
+
+	s[ len ] = 0;
+
+	return s;
+}
+
+/*
+ * getlist() - read a count and that many strings, null-terminated
+ */
+
+static char **
+getlist(
+	FILE	*f,
+	long	*n )
+{
+	char	**l;
+	long	i;
+
+	if( !getnum( f, n ) || *n < 0 ||
+	    !( l = (char **)calloc( *n + 1, sizeof( char * ) ) ) )
+		return 0;
+
+	for( i = 0; i < *n; i++ )
+	    if( !( l[i] = getstr( f ) ) )
+	{
+	    freelist( l, i );
+	    return 0;
+	}
+
+	return l;
+}
+
+/*
+ * freelist() - free what getlist() returned
+ */
+
+static void
+freelist(
+	char	**l,
+	long	n )
+{
+	while( n-- > 0 )
+	    free( l[n] );
+
+	free( (char *)l );
+}
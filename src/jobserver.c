@@ -0,0 +1,305 @@
+/*
+ * Copyright 1993-2002 Christopher Seiwald and Perforce Software, Inc.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * jobserver.c - share a -j budget with make(1) through its jobserver
+ *
+ * GNU make hands out parallelism as single byte tokens in a pipe (or,
+ * in newer versions, a named fifo), advertised to sub-makes in
+ * MAKEFLAGS as --jobserver-auth=R,W or --jobserver-auth=fifo:PATH.
+ * Every process in the tree may run one job for free; each further
+ * job needs a token read from the pipe, which goes back when the job
+ * is done.  This way nested builds together never run more than the
+ * top level -j.
+ *
+ * If jam finds such a jobserver in MAKEFLAGS, it acts as a client:
+ * execcmd() takes a token before each command beyond the first, and
+ * execwait() gives them back as commands finish.  Without an explicit
+ * -j, a client jam runs as many commands as it gets tokens for, up to
+ * the -j of the top level make.
+ *
+ * If $(JAMJOBSERVER) is set and jam runs with -j greater than 1 (and
+ * is not already a client), it acts as the server: it makes a pipe
+ * holding -j less one tokens and puts it in MAKEFLAGS, so that makes
+ * and jams run by its actions draw from the same budget.  Jam itself
+ * is then just another client of its own pipe.
+ *
+ * When jam has a slot free but no token for it, execwait() watches
+ * the read end along with its own commands (on Linux, in its epoll
+ * set), so that a token freed by another process wakes it at once.
+ *
+ * External routines:
+ *
+ *	jobserver_init() - find or make the jobserver
+ *	jobserver_take() - get a token to run one more command
+ *	jobserver_give() - return tokens no longer needed
+ *	jobserver_want() - the descriptor to watch for a token, if needed
+ *
+ * Internal routines:
+ *
+ *	jobserver_open() - set up the descriptors for the pipe
+ *	jobserver_fifo() - open a named fifo jobserver
+ */
+
+# include "jam.h"
+# include "lists.h"
+# include "variable.h"
+# include "execcmd.h"
+# include "jobserver.h"
+
+# ifdef unix
+# define USE_JOBSERVER
+# endif
+
+# ifdef USE_JOBSERVER
+
+# include <unistd.h>
+# include <fcntl.h>
+# include <poll.h>
+
+static int jsread = -1;		/* read end, ours */
+static int jswrite = -1;	/* write end */
+static int jsnonblock = 0;	/* jsread won't block */
+static char *tokens = 0;	/* held tokens, to give back as taken */
+static int held = 0;
+
+static int jobserver_open( int r, int w );
+static int jobserver_fifo( const char *path );
+
+/*
+ * jobserver_init() - find or make the jobserver
+ */
+
+void
+jobserver_init()
+{
+	const char *flags = getenv( "MAKEFLAGS" );
+	const char *auth = 0;
+	const char *s;
+	LIST *l;
+	int r, w;
+
+	if( globs.noexec )
+	    return;
+
+	/* Make uses the last --jobserver-auth (or older -fds) it finds. */
+
+	for( s = flags; s && ( s = strstr( s, "--jobserver-" ) ); s++ )
+	    if( !strncmp( s, "--jobserver-auth=", 17 ) )
+		auth = s + 17;
+	    else if( !strncmp( s, "--jobserver-fds=", 16 ) )
+		auth = s + 16;
+
+	if( auth )
+	{
+	    if( !strncmp( auth, "fifo:", 5 ) ? !jobserver_fifo( auth + 5 ) :
+		sscanf( auth, "%d,%d", &r, &w ) != 2 || !jobserver_open( r, w ) )
+	    {
+		printf( "warning: jobserver unavailable, ignoring it\n" );
+		return;
+	    }
+
+	    /* Without -j, run as many as make's own -j allows. */
+
+	    if( !globs.jobsset && ( !( s = strstr( flags, " -j" ) ) ||
+		sscanf( s + 3, "%d", &globs.jobs ) != 1 || globs.jobs < 1 ) )
+		    globs.jobs = execcpus();
+
+	    if( DEBUG_EXECCMD )
+		printf( "jobserver: client of %s\n", auth );
+
+	    return;
+	}
+
+	/* Otherwise, be the server if asked to. */
+
+	if( globs.jobs < 2 || !( l = var_get( "JAMJOBSERVER" ) ) || !*l->string )
+	    return;
+
+	{
+	    int fds[2];
+	    char *env;
+	    int i;
+
+	    if( pipe( fds ) < 0 )
+	    {
+		perror( "jobserver" );
+		return;
+	    }
+
+	    for( i = 1; i < globs.jobs; i++ )
+		if( write( fds[1], "+", 1 ) != 1 )
+		    break;
+
+	    /* putenv() keeps the string: it must live on. */
+
+	    env = malloc( strlen( flags ? flags : "" ) + 80 );
+	    sprintf( env, "MAKEFLAGS=%s -j%d --jobserver-auth=%d,%d",
+		flags ? flags : "", globs.jobs, fds[0], fds[1] );
+	    putenv( env );
+
+	    jobserver_open( fds[0], fds[1] );
+
+	    if( DEBUG_EXECCMD )
+		printf( "jobserver: serving %d tokens on %d,%d\n",
+		    i - 1, fds[0], fds[1] );
+	}
+}
+
+/*
+ * jobserver_open() - set up the descriptors for the pipe
+ *
+ * The descriptors stay open across exec for the commands we run.  The
+ * read end is shared with them, so we can't leave it non-blocking; on
+ * Linux, opening /dev/fd/N gets us a private one that we can.
+ * Elsewhere jobserver_take() makes it non-blocking just to read.
+ */
+
+static int
+jobserver_open(
+	int	r,
+	int	w )
+{
+	if( fcntl( r, F_GETFD ) < 0 || fcntl( w, F_GETFD ) < 0 )
+	    return 0;
+
+	jsread = r;
+	jswrite = w;
+
+# ifdef OS_LINUX
+	{
+	    char path[ 32 ];
+	    int fd;
+
+	    sprintf( path, "/dev/fd/%d", r );
+
+	    if( ( fd = open( path, O_RDONLY | O_NONBLOCK ) ) >= 0 )
+	    {
+		fcntl( fd, F_SETFD, FD_CLOEXEC );
+		jsread = fd;
+		jsnonblock = 1;
+	    }
+	}
+# endif
+
+	return 1;
+}
+
+/*
+ * jobserver_fifo() - open a named fifo jobserver
+ */
+
+static int
+jobserver_fifo( const char *path )
+{
+	char buf[ MAXJPATH ];
+	int len = strcspn( path, " \t" );
+	int fd;
+
+	if( len >= MAXJPATH )
+	    return 0;
+
+	memcpy( buf, path, len );
+	buf[ len ] = 0;
+
+	if( ( fd = open( buf, O_RDWR | O_NONBLOCK ) ) < 0 )
+	    return 0;
+
+	fcntl( fd, F_SETFD, FD_CLOEXEC );
+	jsread = jswrite = fd;
+	jsnonblock = 1;
+
+	return 1;
+}
+
+/*
+ * jobserver_take() - get a token to run one more command
+ *
+ * With running commands already going, returns 1 if we may launch
+ * another, either on a token we already hold or one we could read
+ * without waiting; 0 if the caller must wait for a command to finish.
+ */
+
+int
+jobserver_take( int running )
+{
+	char c;
+
+	if( jsread < 0 || running < 1 + held )
+	    return 1;
+
+	if( !jsnonblock )
+	{
+	    struct pollfd p;
+	    int flags, n;
+
+	    p.fd = jsread;
+	    p.events = POLLIN;
+
+	    if( poll( &p, 1, 0 ) <= 0 )
+		return 0;
+
+	    /* Another client may take the token before we read it: */
+	    /* don't wait for the next one. */
+
+	    if( ( flags = fcntl( jsread, F_GETFL ) ) < 0 )
+		return 0;
+
+	    fcntl( jsread, F_SETFL, flags | O_NONBLOCK );
+	    n = read( jsread, &c, 1 );
+	    fcntl( jsread, F_SETFL, flags );
+
+	    if( n != 1 )
+		return 0;
+	}
+	else if( read( jsread, &c, 1 ) != 1 )
+	{
+	    return 0;
+	}
+
+	if( !tokens )
+	    tokens = malloc( globs.jobs + 1 );
+
+	tokens[ held++ ] = c;
+
+	return 1;
+}
+
+/*
+ * jobserver_give() - return tokens no longer needed
+ *
+ * Called with the number of commands still running: we keep one token
+ * for each of those beyond the first, the free one.
+ */
+
+void
+jobserver_give( int running )
+{
+	while( held > 0 && held > running - 1 )
+	    if( write( jswrite, &tokens[ --held ], 1 ) != 1 )
+		break;
+}
+
+/*
+ * jobserver_want() - the descriptor to watch for a token, if needed
+ *
+ * Returns -1 if another command could run without a new token.
+ */
+
+int
+jobserver_want( int running )
+{
+	return running < 1 + held ? -1 : jsread;
+}
+
+# else
+
+void jobserver_init() {}
+int jobserver_take( int running ) { return 1; }
+void jobserver_give( int running ) {}
+int jobserver_want( int running ) { return -1; }
+
+# endif /* USE_JOBSERVER */
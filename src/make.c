@@ -16,12 +16,18 @@
  * make0().  The second pass, make1(), which actually does the command
  * execution, is in make1.c.
  *
+ * If $(JAMOVERLAP) is set, make0() doesn't leave all the building to
+ * make1() afterwards: as soon as a target's fate is settled and all it
+ * depends on has gone before it, make0() passes it to make1early(), so
+ * that commands run while the rest of the graph is being bound.
+ *
  * External routines:
  *	make() - make a target, given its name
  *
  * Internal routines:
  * 	make0() - bind and scan everything to make a TARGET
  * 	make0sort() - reorder TARGETS chain by their time (newest to oldest)
+ *	make0settled() - can make1() start on a target before make0() is done?
  *
  * 12/26/93 (seiwald) - allow NOTIME targets to be expanded via $(<), $(>)
  * 01/04/94 (seiwald) - print all targets, bounded, when tracing commands
@@ -63,6 +69,8 @@
 # include "make.h"
 # include "headers.h"
 # include "command.h"
+# include "history.h"
+# include "jobserver.h"
 
 # ifndef max
 # define max( a,b ) ((a)>(b)?(a):(b))
@@ -81,6 +89,9 @@ static void make0( TARGET *t, TARGET *p, int depth,
 		COUNTS *counts, int anyhow );
 
 static TARGETS *make0sort( TARGETS *c );
+static int make0settled( TARGET *t );
+
+static int overlap = 0;		/* $(JAMOVERLAP): start make1() early */
 
 static const char *target_fate[] = 
 {
@@ -122,6 +133,7 @@ make(
 	COUNTS counts[1];
 	int status = 0;		/* 1 if anything fails */
 	TARGET *t;
+	LIST *l;
 
 	memset( (char *)counts, 0, sizeof( *counts ) );
 
@@ -132,7 +144,18 @@ make(
 	for( i = 0; i < n_targets; i++ )
 	    t->depends = targetentry( t->depends, bindtarget( targets[ i ] ) );
 
-	/* Bind and scan */
+	/* Pick up durations of actions run before */
+
+	history_init();
+
+	/* Join (or start) a jobserver shared with nested builds */
+
+	jobserver_init();
+
+	/* Bind and scan, maybe building as we go */
+
+	if( ( l = var_get( "JAMOVERLAP" ) ) && *l->string )
+	    overlap = 1;
 
 	make0( t, 0, 0, counts, anyhow );
 
@@ -158,6 +181,8 @@ make(
 
 	status |= make1( t );
 
+	history_done();
+
 	return status;
 }
 
@@ -178,7 +203,7 @@ make0(
 {
 	TARGETS	*c, *d, *incs;
 	TARGET 	*ptime = t;
-	time_t	last, leaf, hlast;
+	time_t	last, leaf, hlast, when;
 	int	fate;
 	const char *flag = "";
 	SETTINGS *s;
@@ -267,7 +292,11 @@ make0(
 	 * Step 3: recursively make0() dependents & headers
 	 */
 
-	/* Step 3a: recursively make0() dependents */
+	/* Step 3a: recursively make0() dependents, having first */
+	/* started their header scans on threads, where there are any. */
+
+	for( c = t->depends; c; c = c->next )
+	    headers_prefetch( c->target );
 
 	for( c = t->depends; c; c = c->next )
 	{
@@ -441,8 +470,14 @@ make0(
 
 	/* Step 4f: propagate dependents' time & fate. */
 	/* Set leaf time to be our time only if this is a leaf. */
+	/* A restat target that last came out unchanged (and hasn't */
+	/* been touched since) is as old as its contents. */
 
-	t->time = max( t->time, last );
+	if( fate < T_FATE_BUILD && t->binding == T_BIND_EXISTS &&
+	    ( when = history_restat( t->boundname, t->time ) ) < t->time )
+		t->time = when;
+	else
+		t->time = max( t->time, last );
 	t->leaf = leaf ? leaf : t->time ;
 	t->fate = fate;
 
@@ -453,6 +488,13 @@ make0(
 	if( globs.newestfirst )
 	    t->depends = make0sort( t->depends );
 
+	/*
+	 * Step 5a: under $(JAMOVERLAP), let make1() start on it now.
+	 */
+
+	if( overlap && make0settled( t ) )
+	    make1early( t );
+
 	/* 
 	 * Step 6: a little harmless tabulating for tracing purposes 
 	 */
@@ -490,6 +532,38 @@ make0(
 		printf( "%s %s\n", target_fate[ t->fate ], t->name );
 }
 
+/*
+ * make0settled() - can make1() start on a target before make0() is done?
+ *
+ * Only if all its dependents were passed to make1early() before it,
+ * and everything its actions touch has been bound, so that nothing
+ * make0() has yet to do could change what they'd run.
+ */
+
+static int
+make0settled( TARGET *t )
+{
+	TARGETS	*c;
+	ACTIONS	*a;
+
+	for( c = t->depends; c; c = c->next )
+	    if( c->target->progress == T_MAKE_INIT )
+		return 0;
+
+	for( a = t->actions; a; a = a->next )
+	{
+	    for( c = a->action->targets; c; c = c->next )
+		if( c->target->fate <= T_FATE_MAKING )
+		    return 0;
+
+	    for( c = a->action->sources; c; c = c->next )
+		if( c->target->fate <= T_FATE_MAKING )
+		    return 0;
+	}
+
+	return 1;
+}
+
 /*
  * make0sort() - reorder TARGETS chain by their time (newest to oldest)
  */
@@ -11,23 +11,102 @@
  * recursively decend the dependency graph executing update actions as
  * marked by make0().
  *
+ * Targets whose commands are ready to run wait on a single ready queue,
+ * ordered by how critical they are: the longest chain of actions still
+ * to run between the target and the top of the graph, weighed by how
+ * long each action took last time if $(JAMHISTORY) keeps track.  Make1() keeps 
+ * taking the most critical ready target off the queue and launching its
+ * next command, so long link chains start early rather than in whatever
+ * order the depth-first traversal happens to reach their leaves.
+ *
+ * Under -q, what matters most is hearing of a failure early, so with
+ * $(JAMHISTORY) targets rank ahead of all others if an action of
+ * theirs failed last time (as do the targets they depend on, which
+ * must be done before we can find out whether it still fails), and
+ * next if any of their dependencies changed since the last run.  The
+ * critical path only orders targets of the same rank.
+ *
+ * If $(JAMCACHE) is set, a target's commands are looked up in the
+ * action cache (see cache.c) before any are run, and its outputs
+ * restored from there if they're found.
+ *
+ * Make0() settles every target's fate before anything is run, so when
+ * an 'actions restat' target is rebuilt byte for byte the same, its
+ * parents would still be rebuilt.  Make1() compares the target's 
+ * contents before and after, and if they're the same marks it stable,
+ * with the time its contents last changed; make1b() then skips any
+ * parent that was only being updated on account of such targets.
+ * The file keeps its new time: with $(JAMHISTORY), the older time is
+ * recorded there (see history.c) for make0() to use next time.
+ *
+ * When the command of an 'actions batch' target comes off the queue,
+ * make1e() also takes off the queue any other targets whose next
+ * command is of the same rule, and runs them all as one shell script.
+ * Each command runs in a subshell, so that an exit or cd in it doesn't
+ * reach the others, followed by "|| exit k", k being its place in the
+ * script, so that the exit code tells which failed; those before it
+ * succeeded, and those after it go back on the queue.  Each target
+ * taken along needs room under -m and a slot in its job pool, just as
+ * if it were run alone.
+ *
+ * A target whose $(JOBPOOL) names a pool declared with the JobPool rule
+ * runs its commands only when fewer than the pool's limit are running:
+ * otherwise make1e() sets it aside on the pool, and make1d() puts the
+ * most critical one back on the ready queue when a command finishes.
+ *
+ * Under -m, each command is expected to use as much memory as it did
+ * at its peak last time ($(JAMHISTORY) keeps the peaks execrss() gives
+ * us).  If the most critical command wouldn't fit alongside those
+ * running, make1e() puts it back and make1run() waits for one of them
+ * to finish.  Commands taken along in a batch must fit as well.
+ *
+ * Under $(JAMOVERLAP), make0() hands targets to make1early() as soon
+ * as their fates are settled, and their commands start running while
+ * make0() binds the rest of the graph.  Make1early() only launches
+ * commands while there are free slots (and jobserver tokens to be had
+ * without waiting) and room under -m, and only picks up completions
+ * that are already there, so binding never waits on a command.  The
+ * final make1() call takes up whatever is left.  Targets queued before
+ * their parents are known are only as critical as their own actions.
+ *
  * External routines:
  *
  *	make1() - execute commands to update a TARGET and all its dependents
+ *	make1early() - start on a target make0() has settled
+ *	make1pool() - set how many commands a job pool may run at once
  *
  * Internal routines, the recursive/asynchronous command executors:
  *
  *	make1a() - recursively traverse target tree, calling make1b()
  *	make1b() - dependents of target built, now build target with make1c()
- *	make1c() - launch target's next command, call make1b() when done
+ *	make1c() - queue target's next command, call make1b() when done
  *	make1d() - handle command execution completion and call back make1c()
+ *	make1e() - launch the next command of a target taken off the queue
+ *	make1run() - launch ready commands, and drive finished ones
+ *	make1batchd() - hand out the completion of a batch to its targets
  *
  * Internal support routines:
  *
+ *	make1next() - a target's next command, building them if need be
+ *	make1show() - say what command is being run
+ *	make1batch() - run a target's command along with others of its rule
  *	make1cmds() - turn ACTIONS into CMDs, grouping, splitting, etc
  *	make1list() - turn a list of targets into a LIST, for $(<) and $(>)
+ *	make1sizes() - measure what each source adds to a command's length
+ *	make1pack() - fit as many sources as will go into one command
  * 	make1settings() - for vars that get bound, build up replacement lists
  * 	make1bind() - bind targets that weren't bound in dependency analysis
+ *	make1push() - put a target on the ready queue
+ *	make1pop() - take the most critical target off the ready queue
+ *	make1sift() - restore heap order below a ready queue entry
+ *	make1crit() - compute how critical a target is
+ *	make1restat() - note a restat target's time and contents
+ *	make1unchanged() - see if a restat target came out the same
+ *	make1prune() - skip a target whose dependents all came out the same
+ *	make1findpool() - find the declared pool a target's $(JOBPOOL) names
+ *	make1take() - take a slot in a target's job pool, or wait for one
+ *	make1give() - give back a slot in a target's job pool
+ *	make1room() - see if there's memory under -m for a target's command
  *
  * 04/16/94 (seiwald) - Split from make.c.
  * 04/21/94 (seiwald) - Handle empty "updated" actions.
@@ -61,16 +140,42 @@
 # include "make.h"
 # include "command.h"
 # include "execcmd.h"
+# include "history.h"
+# include "cache.h"
+# include "filesys.h"
+# include "timestamp.h"
+# include "md5.h"
 
 static void make1a( TARGET *t, TARGET *parent );
 static void make1b( TARGET *t );
 static void make1c( TARGET *t );
 static void make1d( void *closure, int status );
+static int make1e( TARGET *t );
+static int make1run( int wait );
+
+static CMD *make1next( TARGET *t );
+static int make1show( CMD *cmd );
+static int make1batch( TARGET *t );
 
 static CMD *make1cmds( ACTIONS *a0 );
 static LIST *make1list( LIST *l, TARGETS *targets, int flags );
+static int make1len( RULE *rule, LIST *nt, LIST *ns, char *buf, int maxline );
+static int *make1sizes( RULE *rule, LIST *nt, LIST *ns, int maxline, int *base );
+static int make1pack( int *sizes, int base, int start, int length, int maxline );
 static SETTINGS *make1settings( LIST *vars );
 static void make1bind( TARGET *t, int warn );
+static void make1push( TARGET *t );
+static TARGET *make1pop();
+static void make1sift( int i );
+static int make1crit( TARGET *t );
+static char *make1restat( TARGET *t );
+static void make1unchanged( TARGET *t );
+static void make1prune( TARGET *t );
+static int make1take( TARGET *t );
+static void make1give( TARGET *t );
+static int make1room( TARGET *t, CMD *cmd );
+
+# define max( a,b ) ((a)>(b)?(a):(b))
 
 /* Ugly static - it's too hard to carry it through the callbacks. */
 
@@ -79,26 +184,96 @@ static struct {
 	int	skipped;
 	int	total;
 	int	made;
+	int	cached;
+	int	unchanged;
+	int	pruned;
 } counts[1] ;
 
+/* Batches run as one script: exit codes 1-MAXBATCH say which failed */
+
+# ifdef unix
+# define USE_BATCH
+# endif
+
+# define MAXBATCH	100
+
+typedef struct {
+	int	n;
+	long	start;		/* history_clock() when launched */
+	char	*buf;		/* the script */
+	TARGET	*targets[ MAXBATCH ];
+} BATCH ;
+
+# ifdef USE_BATCH
+static void make1batchd( void *closure, int status );
+# endif
+
+/* Job pools, from the JobPool rule: few enough for a list. */
+
+typedef struct _pool POOL;
+
+struct _pool {
+	POOL		*next;
+	const char	*name;
+	int		limit;
+	int		running;
+	TARGET		**waiting;	/* for a slot, in no order */
+	int		nwaiting;
+	int		size;
+} ;
+
+static POOL *pools = 0;
+
+static POOL *make1findpool( TARGET *t );
+
+/* Expected peak KB of the commands running, for -m */
+
+static long memused = 0;
+
+/* What a restat target was before its actions ran. */
+
+typedef struct {
+	time_t		time;
+	unsigned char	digest[ MD5_SIZE ];
+} RESTAT ;
+
+/* The ready queue: a heap of targets, most critical on top. */
+/* Until the initial traversal is done, entries are just appended, */
+/* as not all parents (and thus priorities) are known yet. */
+
+typedef struct {
+	TARGET	*target;
+	int	seq;		/* FIFO among equals */
+} READY ;
+
+static struct {
+	READY	*tab;
+	int	count;
+	int	size;
+	int	seq;
+	int	heaped;		/* tab is in heap order */
+} ready[1] ;
+
 /*
  * make1() - execute commands to update a TARGET and all its dependents
  */
 
 static int intr = 0;
+static int begun = 0;
 
 int
 make1( TARGET *t )
 {
-	memset( (char *)counts, 0, sizeof( *counts ) );
+	if( !begun++ )
+	    memset( (char *)counts, 0, sizeof( *counts ) );
 
 	/* Recursively make the target and its dependents */
 
 	make1a( t, (TARGET *)0 );
 
-	/* Wait for any outstanding commands to finish running. */
+	/* Run everything */
 
-	while( execwait() )
+	while( make1run( 1 ) )
 	    ;
 
 	/* Talk about it */
@@ -112,9 +287,72 @@ make1( TARGET *t )
 	if( DEBUG_MAKE && counts->made )
 	    printf( "...updated %d target(s)...\n", counts->made );
 
+	if( DEBUG_MAKE && counts->cached )
+	    printf( "...of which %d from the cache...\n", counts->cached );
+
+	if( DEBUG_MAKE && counts->pruned )
+	    printf( "...skipped %d target(s) with unchanged sources...\n",
+		counts->pruned );
+
 	return counts->total != counts->made;
 }
 
+/*
+ * make1early() - start on a target make0() has settled
+ *
+ * Make0() calls this (under $(JAMOVERLAP)) for each target whose fate
+ * is final, whose dependents have all been passed here before it, and
+ * whose actions' targets and sources are all bound.  It then gets on
+ * with whatever commands can run without waiting.
+ */
+
+void
+make1early( TARGET *t )
+{
+	if( !begun++ )
+	    memset( (char *)counts, 0, sizeof( *counts ) );
+
+	make1a( t, (TARGET *)0 );
+
+	while( make1run( 0 ) )
+	    ;
+}
+
+/*
+ * make1run() - launch ready commands, and drive finished ones
+ *
+ * Launches the most critical ready command if there is one and room
+ * for it, otherwise drives a command completion (which may queue
+ * more).  Returns 0 when there's nothing to do; with wait, only once
+ * all is done, and without, as soon as that would mean waiting.
+ */
+
+static int
+make1run( int wait )
+{
+	TARGET *r;
+
+	/* Under -l or -p, while the system is busy, let the commands */
+	/* running finish rather than starting more.  Likewise while */
+	/* every slot is taken. */
+
+	if( ready->count && ( execload() || !execready() ) )
+	{
+	    if( wait ? execwait() : execpoll() )
+		return 1;
+	    else if( !wait )
+		return 0;
+	}
+
+	/* If the command had to go back for want of memory, let the */
+	/* commands running finish. */
+
+	if( ( r = make1pop() ) && make1e( r ) )
+	    return 1;
+
+	return wait ? execwait() : execpoll();
+}
+
 /*
  * make1a() - recursively traverse target tree, calling make1b()
  */
@@ -194,6 +432,13 @@ make1b( TARGET *t )
 	    t->status = c->target->status;
 	}
 
+	/* If restat actions left dependents unchanged, this target */
+	/* may not need updating after all. */
+
+	if( counts->unchanged && t->status == EXEC_CMD_OK && 
+	    t->fate == T_FATE_UPDATE )
+		make1prune( t );
+
 	/* If actions on deps have failed, bail. */
 	/* Otherwise, execute all actions to make target */
 
@@ -240,27 +485,28 @@ make1b( TARGET *t )
 		if( DEBUG_MAKE && !( counts->total % 100 ) )
 		    printf( "...on %dth target...\n", counts->total );
 
-		pushsettings( t->settings );
-		t->cmds = (char *)make1cmds( t->actions );
-		popsettings( t->settings );
-
 		t->progress = T_MAKE_RUNNING;
 	    }
 
 	    break;
 	}
 
-	/* Call make1c() to begin the execution of the chain of commands */
-	/* needed to build target.  If we're not going to build target */
-	/* (because of dependency failures or because no commands need to */
-	/* be run) the chain will be empty and make1c() will directly */
-	/* signal the completion of target. */
+	/* If we're going to build target, queue it: make1e() turns its */
+	/* actions into commands once it comes off the ready queue, so */
+	/* that only the targets actually being built hold CMDs. */
 
-	make1c( t );
+	/* If we're not going to build target (because of dependency */
+	/* failures or because no commands need to be run) make1c() will */
+	/* directly signal the completion of target. */
+
+	if( t->progress == T_MAKE_RUNNING )
+	    make1push( t );
+	else
+	    make1c( t );
 }
 
 /*
- * make1c() - launch target's next command, call make1b() when done
+ * make1c() - queue target's next command, call make1b() when done
  */
 
 static void
@@ -270,7 +516,7 @@ make1c( TARGET *t )
 
 	/* If there are (more) commands to run to build this target */
 	/* (and we haven't hit an error running earlier comands) we */
-	/* launch the command with execcmd(). */
+	/* put it back on the ready queue for make1e() to launch. */
 
 	/* If there are no more commands to run, we collect the status */
 	/* from all the actions then report our completion to all the */
@@ -278,35 +524,22 @@ make1c( TARGET *t )
 
 	if( cmd && t->status == EXEC_CMD_OK )
 	{
-	    if( DEBUG_MAKE )
-		if( DEBUG_MAKEQ || ! ( cmd->rule->flags & RULE_QUIETLY ) )
-	    {
-		printf( "%s ", cmd->rule->name );
-		list_print( lol_get( &cmd->args, 0 ) );
-		printf( "\n" );
-	    }
-
-	    if( DEBUG_EXEC )
-		printf( "%s\n", cmd->buf );
-
-	    if( globs.cmdout )
-		fprintf( globs.cmdout, "%s", cmd->buf );
-
-	    if( globs.noexec )
-	    {
-		make1d( t, EXEC_CMD_OK );
-	    }
-	    else
-	    {
-		fflush( stdout );
-		execcmd( cmd->buf, make1d, t, cmd->shell );
-	    }
+	    make1push( t );
 	}
 	else
 	{
 	    TARGETS	*c;
 	    ACTIONS	*actions;
 
+	    /* Drop any commands left unrun after a failure. */
+
+	    while( cmd )
+	    {
+		t->cmds = (char *)cmd_next( cmd );
+		cmd_free( cmd );
+		cmd = (CMD *)t->cmds;
+	    }
+
 	    /* Collect status from actions, and distribute it as well */
 
 	    for( actions = t->actions; actions; actions = actions->next )
@@ -317,6 +550,28 @@ make1c( TARGET *t )
 		if( t->status > actions->action->status )
 		    actions->action->status = t->status;
 
+	    /* See if a restat target came out the same. */
+
+	    if( t->restat )
+	    {
+		if( t->status == EXEC_CMD_OK && t->progress == T_MAKE_RUNNING )
+		    make1unchanged( t );
+
+		free( t->restat );
+		t->restat = 0;
+	    }
+
+	    /* Save what the commands made in the action cache. */
+
+	    if( t->cache )
+	    {
+		if( t->status == EXEC_CMD_OK )
+		    cache_store( (CACHEKEY *)t->cache );
+
+		cache_free( (CACHEKEY *)t->cache );
+		t->cache = 0;
+	    }
+
 	    /* Tally success/failure for those we tried to update. */
 
 	    if( t->progress == T_MAKE_RUNNING )
@@ -351,6 +606,11 @@ make1d(
 	TARGET	*t = (TARGET *)closure;
 	CMD	*cmd = (CMD *)t->cmds;
 
+	make1give( t );
+
+	memused -= cmd->rss;
+	cmd->rss = 0;
+
 	/* Execcmd() has completed.  All we need to do is fiddle with the */
 	/* status and signal our completion so make1c() can run the next */
 	/* command.  On interrupts, we bail heavily. */
@@ -393,6 +653,26 @@ make1d(
 		    printf( "...removing %s\n", targets->string );
 	}
 
+	/* Note how long it took, for next time.  A command that never */
+	/* ran (its response file couldn't be written) has no start. */
+
+	if( !globs.noexec && status != EXEC_CMD_INTR && cmd->start )
+	{
+	    LIST *targets = lol_get( &cmd->args, 0 );
+	    long ms = history_clock() - cmd->start;
+
+	    if( ms < 0 )
+		ms = 0;
+
+	    if( DEBUG_TIMES )
+		printf( "time\t%ld.%03lds\t%s %s\n", ms / 1000, ms % 1000,
+		    cmd->rule->name, targets ? targets->string : "" );
+
+	    if( targets )
+		history_record( cmd->rule->name, targets->string, 
+		    ms, status, execrss(), cmd->buf );
+	}
+
 	/* Free this command and call make1c() to move onto next command. */
 
 	t->status = status;
@@ -403,6 +683,360 @@ make1d(
 	make1c( t );
 }
 
+/*
+ * make1e() - launch the next command of a target taken off the queue
+ *
+ * Returns 0 if the command had to go back on the queue to wait for
+ * memory under -m, 1 otherwise.
+ */
+
+static int
+make1e( TARGET *t )
+{
+	CMD	*cmd;
+
+	/* If interrupted meanwhile, or there turned out to be nothing */
+	/* to run, let make1c() wrap up. */
+
+	if( !( cmd = make1next( t ) ) )
+	{
+	    make1c( t );
+	    return 1;
+	}
+
+	/* Wait for memory enough under -m, then for a slot in the */
+	/* job pool, if it's full.  Make1d() gives both back, whatever */
+	/* happens. */
+
+	if( !make1room( t, cmd ) )
+	{
+	    make1push( t );
+	    return 0;
+	}
+
+	if( !make1take( t ) )
+	{
+	    memused -= cmd->rss;
+	    cmd->rss = 0;
+	    return 1;
+	}
+
+	/* 'actions batch' may take other targets along. */
+
+	if( ( cmd->rule->flags & RULE_BATCH ) && make1batch( t ) )
+	    return 1;
+
+	/* Write out the sources of 'actions response'. */
+
+	if( make1show( cmd ) )
+	{
+	    make1d( t, EXEC_CMD_FAIL );
+	    return 1;
+	}
+
+	if( globs.noexec )
+	{
+	    make1d( t, EXEC_CMD_OK );
+	}
+	else
+	{
+	    fflush( stdout );
+	    cmd->start = history_clock();
+	    execcmd( cmd->buf, make1d, t, cmd->shell, &cmd->args );
+	}
+
+	return 1;
+}
+
+# ifdef USE_BATCH
+
+/*
+ * make1batchd() - hand out the completion of a batch to its targets
+ */
+
+static void
+make1batchd(
+	void	*closure,
+	int	status )
+{
+	BATCH	*b = (BATCH *)closure;
+	long	now = history_clock();
+	long	share = ( now - b->start ) / b->n;
+	int	failed = -1;
+	int	i;
+
+	/* Exit code k: the kth command failed.  Anything else */
+	/* (e.g. the shell was killed) goes for the lot. */
+
+	if( status == EXEC_CMD_FAIL )
+	{
+	    int k = execexit();
+
+	    if( k >= 1 && k <= b->n )
+		failed = k - 1;
+	}
+
+	for( i = 0; i < b->n; i++ )
+	{
+	    TARGET *t = b->targets[i];
+
+	    /* Split the time evenly, for the history. */
+
+	    ( (CMD *)t->cmds )->start = now - share;
+
+	    if( failed < 0 )
+		make1d( t, status );
+	    else if( i < failed )
+		make1d( t, EXEC_CMD_OK );
+	    else if( i == failed )
+		make1d( t, EXEC_CMD_FAIL );
+	    else
+	    {
+		/* Not run: give back its memory and pool slot until */
+		/* it's launched. */
+
+		memused -= ( (CMD *)t->cmds )->rss;
+		( (CMD *)t->cmds )->rss = 0;
+		make1give( t );
+		make1push( t );
+	    }
+	}
+
+	free( b->buf );
+	free( (char *)b );
+}
+
+# endif /* USE_BATCH */
+
+/*
+ * make1next() - a target's next command, building them if need be
+ *
+ * Returns 0 if there's nothing (more) to run, or the target has
+ * failed or been interrupted.
+ */
+
+static CMD *
+make1next( TARGET *t )
+{
+	CMD	*cmd;
+
+	/* A target fresh from make1b() has yet to have its actions */
+	/* turned into commands.  Set "on target" vars, build actions, */
+	/* unset vars. */
+
+	if( intr )
+	    t->status = EXEC_CMD_INTR;
+
+	if( !t->cmds && t->status == EXEC_CMD_OK )
+	{
+	    LIST *pool;
+
+	    pushsettings( t->settings );
+	    t->cmds = (char *)make1cmds( t->actions );
+
+	    if( ( pool = var_get( "JOBPOOL" ) ) )
+		t->jobpool = pool->string;
+
+	    if( t->cmds )
+	    {
+		t->restat = make1restat( t );
+		t->cache = (char *)cache_key( t, (CMD *)t->cmds );
+	    }
+
+	    popsettings( t->settings );
+
+	    /* If the action cache has what the commands would make, */
+	    /* just say what they would have been. */
+
+	    if( t->cache && cache_fetch( (CACHEKEY *)t->cache ) )
+	    {
+		++counts->cached;
+
+		cache_free( (CACHEKEY *)t->cache );
+		t->cache = 0;
+
+		while( ( cmd = (CMD *)t->cmds ) )
+		{
+		    if( DEBUG_MAKE )
+			if( DEBUG_MAKEQ || ! ( cmd->rule->flags & RULE_QUIETLY ) )
+		    {
+			printf( "%s ", cmd->rule->name );
+			list_print( lol_get( &cmd->args, 0 ) );
+			printf( "(cached)\n" );
+		    }
+
+		    t->cmds = (char *)cmd_next( cmd );
+		    cmd_free( cmd );
+		}
+	    }
+	}
+
+	return t->status == EXEC_CMD_OK ? (CMD *)t->cmds : 0;
+}
+
+/*
+ * make1show() - say what command is being run
+ *
+ * Also writes the sources of 'actions response', returning -1 if 
+ * that fails.
+ */
+
+static int
+make1show( CMD *cmd )
+{
+	if( DEBUG_MAKE )
+	    if( DEBUG_MAKEQ || ! ( cmd->rule->flags & RULE_QUIETLY ) )
+	{
+	    printf( "%s ", cmd->rule->name );
+	    list_print( lol_get( &cmd->args, 0 ) );
+	    printf( "\n" );
+	}
+
+	if( DEBUG_EXEC )
+	    printf( "%s\n", cmd->buf );
+
+	if( globs.cmdout )
+	    fprintf( globs.cmdout, "%s", cmd->buf );
+
+	if( ( !globs.noexec || globs.cmdout ) && cmd_rsp( cmd ) )
+	    return -1;
+
+	return 0;
+}
+
+/*
+ * make1batch() - run a target's command along with others of its rule
+ *
+ * Takes off the ready queue the targets that look to have a command 
+ * of the same rule next, and batches up those that do, as long as the
+ * script fits in execmax().  The rest go back on the queue.
+ *
+ * Returns 0 if there's nothing to batch with, so that make1e() should 
+ * just run the command as usual.
+ */
+
+static int
+make1batch( TARGET *t )
+{
+# ifdef USE_BATCH
+	CMD	*cmd = (CMD *)t->cmds;
+	RULE	*rule = cmd->rule;
+	TARGET	*maybe[ MAXBATCH ];
+	int	nmaybe = 0;
+	int	len, maxline = execmax();
+	BATCH	*b;
+	char	*p;
+	int	i, j;
+
+	/* Only for /bin/sh, and only if we're running commands. */
+
+	if( cmd->shell || globs.noexec )
+	    return 0;
+
+	/* Take likely targets off the queue, and heap it up again. */
+	/* Those fresh from make1b() have no commands yet; it's enough */
+	/* that one of their actions is of the rule. */
+
+	for( i = j = 0; i < ready->count; i++ )
+	{
+	    TARGET *u = ready->tab[i].target;
+	    ACTIONS *a = 0;
+
+	    if( nmaybe < MAXBATCH - 1 && u->status == EXEC_CMD_OK && !u->cmds )
+		for( a = u->actions; a; a = a->next )
+		    if( a->action->rule == rule )
+			break;
+
+	    if( a || ( nmaybe < MAXBATCH - 1 && u->cmds && 
+		( (CMD *)u->cmds )->rule == rule ) )
+		    maybe[ nmaybe++ ] = u;
+	    else
+		ready->tab[ j++ ] = ready->tab[i];
+	}
+
+	if( !nmaybe )
+	    return 0;
+
+	ready->count = j;
+
+	for( i = j / 2; i--; )
+	    make1sift( i );
+
+	/* Batch up those whose next command is indeed of the rule, */
+	/* if there's memory and a pool slot for it.  Make1take() sets */
+	/* aside those whose pool is full. */
+
+	b = (BATCH *)malloc( sizeof( BATCH ) );
+	b->n = 0;
+	b->targets[ b->n++ ] = t;
+	len = strlen( cmd->buf ) + 32;
+
+	for( i = 0; i < nmaybe; i++ )
+	{
+	    TARGET *u = maybe[i];
+	    CMD *c = make1next( u );
+
+	    if( !c )
+		make1c( u );
+	    else if( c->rule != rule || c->shell ||
+		len + strlen( c->buf ) + 32 >= maxline || !make1room( u, c ) )
+		make1push( u );
+	    else if( !make1take( u ) )
+	    {
+		memused -= c->rss;
+		c->rss = 0;
+	    }
+	    else
+	    {
+		b->targets[ b->n++ ] = u;
+		len += strlen( c->buf ) + 32;
+	    }
+	}
+
+	if( b->n == 1 )
+	{
+	    free( (char *)b );
+	    return 0;
+	}
+
+	/* Say what's being run, and write the script: */
+	/* ( cmd ) || exit k for each. */
+
+	b->buf = p = malloc( len );
+
+	for( i = j = 0; i < b->n; i++ )
+	{
+	    TARGET *u = b->targets[i];
+	    CMD *c = (CMD *)u->cmds;
+
+	    if( make1show( c ) )
+	    {
+		make1d( u, EXEC_CMD_FAIL );
+		continue;
+	    }
+
+	    b->targets[ j++ ] = u;
+	    sprintf( p, "(\n%s\n) || exit %d\n", c->buf, j );
+	    p += strlen( p );
+	}
+
+	if( !( b->n = j ) )
+	{
+	    free( b->buf );
+	    free( (char *)b );
+	    return 1;
+	}
+
+	fflush( stdout );
+	b->start = history_clock();
+	execcmd( b->buf, make1batchd, b, (LIST *)0, (LOL *)0 );
+
+	return 1;
+# else
+	return 0;
+# endif
+}
+
 /*
  * make1cmds() - turn ACTIONS into CMDs, grouping, splitting, etc
  *
@@ -431,6 +1065,7 @@ make1cmds( ACTIONS *a0 )
 	    ACTIONS *a1;
 	    CMD	    *cmd;
 	    int	    start, chunk, length, maxline;
+	    int	    *sizes, base, repack;
 
 	    /* Only do rules with commands to execute. */
 	    /* If this action has already been executed, use saved status */
@@ -473,15 +1108,16 @@ make1cmds( ACTIONS *a0 )
 	     * Build command, starting with all source args.
 	     *
 	     * If cmd_new returns 0, it's because the resulting command
-	     * length is > maxline.  In this case, we'll slowly reduce
-	     * the number of source arguments presented until it does
-	     * fit.  This only applies to actions that allow PIECEMEAL
-	     * commands.
+	     * length is > maxline.  For actions that allow PIECEMEAL
+	     * commands, we then expand the command once per source to
+	     * learn how much each adds to its length, and pack the
+	     * sources greedily into commands that fit: that's linear
+	     * in the number of sources, where homing in on the right
+	     * chunk size by trial takes many full expansions.
 	     *
-	     * While reducing slowly takes a bit of compute time to get
-	     * things just right, it's worth it to get as close to maxline
-	     * as possible, because launching the commands we're executing
-	     * is likely to be much more compute intensive!
+	     * If a packed chunk still doesn't fit (because $(>) is used
+	     * in a way that doesn't simply add up, like $(>[1])), we
+	     * fall back to slowly reducing that chunk until it does.
 	     *
 	     * Note we loop through at least once, for sourceless actions.
 	     *
@@ -491,6 +1127,8 @@ make1cmds( ACTIONS *a0 )
 
 	    start = 0;
 	    chunk = length = list_length( ns );
+	    sizes = 0;
+	    base = repack = 0;
 
 	    maxline = rule->flags / RULE_MAXLINE;
 	    maxline = maxline && maxline < execmax() ? maxline : execmax();
@@ -499,7 +1137,12 @@ make1cmds( ACTIONS *a0 )
 	    {
 		/* Build cmd: cmd_new consumes its lists. */
 
-		CMD *cmd = cmd_new( rule,
+		CMD *cmd;
+
+		if( repack )
+		    chunk = make1pack( sizes, base, start, length, maxline );
+
+		cmd = cmd_new( rule,
 			list_copy( L0, nt ),
 			list_sublist( ns, start, chunk ),
 			list_copy( L0, shell ),
@@ -513,12 +1156,22 @@ make1cmds( ACTIONS *a0 )
 		    else cmds->tail->next = cmd;
 		    cmds->tail = cmd;
 		    start += chunk;
+		    repack = sizes != 0;
 		}
 		else if( ( rule->flags & RULE_PIECEMEAL ) && chunk > 1 )
 		{
-		    /* Reduce chunk size slowly. */
+		    /* Pack by size the first time, then reduce slowly. */
+
+		    int packed = chunk;
+
+		    if( !sizes )
+		    {
+			sizes = make1sizes( rule, nt, ns, maxline, &base );
+			packed = make1pack( sizes, base, start, length, maxline );
+		    }
 
-		    chunk = chunk * 9 / 10;
+		    chunk = packed < chunk ? packed : chunk * 9 / 10;
+		    repack = 0;
 		}
 		else
 		{
@@ -531,6 +1184,9 @@ make1cmds( ACTIONS *a0 )
 	    }
 	    while( start < length );
 
+	    if( sizes )
+		free( (char *)sizes );
+
 	    /* These were always copied when used. */
 
 	    list_free( nt );
@@ -546,6 +1202,97 @@ make1cmds( ACTIONS *a0 )
 	return cmds;
 }
 
+/*
+ * make1sizes() - measure what each source adds to a command's length
+ *
+ * Expands the command with each source alone, and once with the first
+ * two: from those we get the length of the command's fixed part (into
+ * *base) and what each source adds to it.
+ */
+
+static int
+make1len(
+	RULE	*rule,
+	LIST	*nt,
+	LIST	*ns,
+	char	*buf,
+	int	maxline )
+{
+	LOL	lol;
+	int	len;
+
+	lol_init( &lol );
+	lol_add( &lol, list_copy( L0, nt ) );
+	lol_add( &lol, ns );
+
+	len = var_string( rule->actions, buf, maxline, &lol );
+
+	lol_free( &lol );
+
+	return len < 0 ? maxline : len;
+}
+
+static int *
+make1sizes(
+	RULE	*rule,
+	LIST	*nt,
+	LIST	*ns,
+	int	maxline,
+	int	*base )
+{
+	int	n = list_length( ns );
+	int	*sizes = (int *)malloc( n * sizeof( int ) );
+	char	*buf = malloc( maxline );
+	int	i;
+	LIST	*l;
+
+	for( i = 0, l = ns; l; i++, l = list_next( l ) )
+	    sizes[i] = make1len( rule, nt, list_new( L0, l->string, 1 ),
+			buf, maxline );
+
+	*base = sizes[0] + sizes[1] -
+		make1len( rule, nt, list_sublist( ns, 0, 2 ), buf, maxline );
+
+	if( *base < 0 )
+	    *base = 0;
+
+	for( i = 0; i < n; i++ )
+	    if( ( sizes[i] -= *base ) < 1 )
+		sizes[i] = 1;
+
+	free( buf );
+
+	return sizes;
+}
+
+/*
+ * make1pack() - fit as many sources as will go into one command
+ *
+ * Returns how many of the sources from start on fit, but at least 1.
+ */
+
+static int
+make1pack(
+	int	*sizes,
+	int	base,
+	int	start,
+	int	length,
+	int	maxline )
+{
+	int	room = maxline - 1 - base;
+	int	chunk;
+
+	for( chunk = 0; start + chunk < length; chunk++ )
+	{
+	    if( chunk && sizes[ start + chunk ] > room )
+		break;
+
+	    room -= sizes[ start + chunk ];
+	}
+
+	return chunk;
+}
+
 /*
  * make1list() - turn a list of targets into a LIST, for $(<) and $(>)
  */
@@ -661,3 +1408,477 @@ make1bind(
 	t->binding = t->time ? T_BIND_EXISTS : T_BIND_MISSING;
 	popsettings( t->settings );
 }
+
+/*
+ * make1sift() - restore heap order below a ready queue entry
+ */
+
+# define TARGET_BEFORE( a, b ) \
+	( (a)->rank > (b)->rank || \
+	  ( (a)->rank == (b)->rank && (a)->critical > (b)->critical ) )
+
+# define READY_BEFORE( a, b ) \
+	( TARGET_BEFORE( (a)->target, (b)->target ) || \
+	  ( !TARGET_BEFORE( (b)->target, (a)->target ) && \
+	    (a)->seq < (b)->seq ) )
+
+static void
+make1sift( int i )
+{
+	READY r = ready->tab[ i ];
+
+	/* Move entry i down below any more critical children. */
+
+	for( ;; )
+	{
+	    int c = 2 * i + 1;
+
+	    if( c >= ready->count )
+		break;
+
+	    if( c + 1 < ready->count && 
+		READY_BEFORE( &ready->tab[ c + 1 ], &ready->tab[ c ] ) )
+		    c++;
+
+	    if( !READY_BEFORE( &ready->tab[ c ], &r ) )
+		break;
+
+	    ready->tab[ i ] = ready->tab[ c ];
+	    i = c;
+	}
+
+	ready->tab[ i ] = r;
+}
+
+/*
+ * make1push() - put a target on the ready queue
+ */
+
+static void
+make1push( TARGET *t )
+{
+	READY r;
+	int i;
+
+	if( ready->count == ready->size )
+	{
+	    ready->size = ready->size ? ready->size * 2 : 64;
+	    ready->tab = (READY *)realloc( (char *)ready->tab, 
+				ready->size * sizeof( READY ) );
+	}
+
+	r.target = t;
+	r.seq = ready->seq++;
+
+	/* Until the queue is heaped, just append. */
+
+	i = ready->count++;
+
+	if( ready->heaped )
+	{
+	    make1crit( t );
+
+	    for( ; i; i = ( i - 1 ) / 2 )
+	    {
+		if( !READY_BEFORE( &r, &ready->tab[ ( i - 1 ) / 2 ] ) )
+		    break;
+		ready->tab[ i ] = ready->tab[ ( i - 1 ) / 2 ];
+	    }
+	}
+
+	ready->tab[ i ] = r;
+}
+
+/*
+ * make1pop() - take the most critical target off the ready queue
+ *
+ * The first pop comes after make1a() has traversed the whole graph, 
+ * when every target's parents are known: that's when we can compute 
+ * the priorities of all targets queued so far and heap them up.
+ */
+
+static TARGET *
+make1pop()
+{
+	TARGET *t;
+	int i;
+
+	if( !ready->heaped )
+	{
+	    for( i = 0; i < ready->count; i++ )
+		make1crit( ready->tab[ i ].target );
+
+	    for( i = ready->count / 2; i--; )
+		make1sift( i );
+
+	    ready->heaped = 1;
+
+	    /* With a history, the most critical chain is a fair guess */
+	    /* at how long this will take, however many jobs we run. */
+
+	    if( DEBUG_TIMES && ready->count && history_known() )
+	    {
+		int ms = ready->tab[0].target->critical;
+		printf( "...longest chain of actions: %d.%03ds...\n",
+		    ms / 1000, ms % 1000 );
+	    }
+	}
+
+	if( !ready->count )
+	    return 0;
+
+	t = ready->tab[ 0 ].target;
+
+	if( --ready->count )
+	{
+	    ready->tab[ 0 ] = ready->tab[ ready->count ];
+	    make1sift( 0 );
+	}
+
+	return t;
+}
+
+/*
+ * make1crit() - compute how critical a target is
+ *
+ * A target's priority is its own cost plus the largest priority among
+ * its parents: the length of the longest chain of work between it and
+ * the top of the graph.  The cost of a target is 1, plus for each of 
+ * its actions that has commands to run, the time history_cost() expects
+ * it to take (just 1 when there's no history).
+ *
+ * Under -q, also ranks the target: 2 if one of its actions failed
+ * last time or it is needed by a target ranked 2, else 1 if any of
+ * its dependencies is newer than the end of the last run.
+ */
+
+static int
+make1crit( TARGET *t )
+{
+	TARGETS *c;
+	ACTIONS *a;
+	int	crit = 0;
+	int	rank = 0;
+
+	if( t->critical )
+	    return t->critical;
+
+	for( c = t->parents; c; c = c->next )
+	{
+	    int pcrit = make1crit( c->target );
+
+	    if( pcrit > crit )
+		crit = pcrit;
+
+	    if( c->target->rank == 2 )
+		rank = 2;
+	}
+
+	crit++;
+
+	for( a = t->actions; a; a = a->next )
+	    if( a->action->rule->actions && a->action->targets )
+	{
+	    TARGET *a0 = a->action->targets->target;
+	    const char *name = a0->boundname ? a0->boundname : a0->name;
+	    HISTORY *h;
+
+	    crit += history_cost( a->action->rule->name, name );
+
+	    if( globs.quitquick && 
+		( h = history_find( a->action->rule->name, name ) ) &&
+		h->status == EXEC_CMD_FAIL )
+		    rank = 2;
+	}
+
+	if( globs.quitquick && !rank && history_since() )
+	    for( c = t->depends; c; c = c->next )
+		if( c->target->time > history_since() )
+	{
+	    rank = 1;
+	    break;
+	}
+
+	if( DEBUG_MAKEPROG )
+	    printf( "crit\t--\t%d%s %s\n", crit, 
+		rank == 2 ? " failed" : rank ? " changed" : "", t->name );
+
+	t->rank = rank;
+
+	return t->critical = crit;
+}
+
+/*
+ * make1restat() - note a restat target's time and contents
+ *
+ * Returns a RESTAT for make1unchanged(), or 0 if the target has no
+ * 'actions restat' or doesn't exist yet.  Under -a everything gets
+ * rebuilt anyhow.
+ */
+
+static char *
+make1restat( TARGET *t )
+{
+	RESTAT	*r;
+	ACTIONS	*a;
+
+	if( globs.noexec || globs.anyhow || t->binding != T_BIND_EXISTS )
+	    return 0;
+
+	for( a = t->actions; a; a = a->next )
+	    if( a->action->rule->flags & RULE_RESTAT )
+		break;
+
+	if( !a )
+	    return 0;
+
+	r = (RESTAT *)malloc( sizeof( RESTAT ) );
+
+	timestamp( (char *)t->boundname, &r->time );
+
+	if( !r->time || md5_file( t->boundname, r->digest ) )
+	{
+	    free( (char *)r );
+	    return 0;
+	}
+
+	/* Unchanged last time too?  Then its contents are older still. */
+
+	r->time = history_restat( t->boundname, r->time );
+
+	return (char *)r;
+}
+
+/*
+ * make1unchanged() - see if a restat target came out the same
+ *
+ * If so, it is marked stable, with the time its contents last 
+ * changed; the file's own time is left alone.  Either way, the
+ * history notes how old its contents are, so that next time its
+ * parents don't look out of date either.
+ */
+
+static void
+make1unchanged( TARGET *t )
+{
+	RESTAT	*r = (RESTAT *)t->restat;
+	unsigned char digest[ MD5_SIZE ];
+	time_t	now;
+
+	if( file_time( t->boundname, &now ) < 0 )
+	    return;
+
+	if( md5_file( t->boundname, digest ) ||
+	    memcmp( (char *)digest, (char *)r->digest, MD5_SIZE ) )
+	{
+	    history_unchanged( t->boundname, now, now );
+	    return;
+	}
+
+	history_unchanged( t->boundname, now, r->time );
+
+	t->fate = T_FATE_STABLE;
+	t->time = r->time;
+
+	++counts->unchanged;
+
+	if( DEBUG_MAKE )
+	    printf( "...%s unchanged...\n", t->name );
+}
+
+/*
+ * make1prune() - skip a target whose dependents all came out the same
+ *
+ * Called by make1b() for a target make0() decided to update only 
+ * because dependents were being updated.  If none of them still is
+ * (restat targets that came out unchanged are now stable) and the
+ * target is no older than any of them, it is stable too.  Its own
+ * parents, in turn, get the same treatment.
+ */
+
+static void
+make1prune( TARGET *t )
+{
+	TARGETS	*c;
+	time_t	last = 0;
+	time_t	own = 0;
+	int	fate = T_FATE_STABLE;
+
+	if( globs.anyhow || t->flags & ( T_FLAG_LEAVES | T_FLAG_TOUCHED ) )
+	    return;
+
+	for( c = t->depends; c; c = c->next )
+	{
+	    fate = max( fate, c->target->fate );
+	    last = max( last, c->target->time );
+	}
+
+	if( fate >= T_FATE_SPOIL )
+	    return;
+
+	/* A file must exist and be newer than its dependents; NOTFILE */
+	/* targets just take on their time. */
+
+	if( !( t->flags & T_FLAG_NOTFILE ) )
+	{
+	    if( t->binding != T_BIND_EXISTS )
+		return;
+
+	    timestamp( (char *)t->boundname, &own );
+
+	    if( last > own )
+		return;
+	}
+
+	t->fate = T_FATE_STABLE;
+	t->time = max( own, last );
+
+	if( t->actions )
+	    ++counts->pruned;
+
+	if( DEBUG_CAUSES )
+	    printf( "...%s needn't be updated...\n", t->name );
+}
+
+/*
+ * make1pool() - set how many commands a job pool may run at once
+ */
+
+void
+make1pool(
+	const char	*name,
+	int		limit )
+{
+	POOL *p;
+
+	for( p = pools; p; p = p->next )
+	    if( !strcmp( p->name, name ) )
+		break;
+
+	if( !p )
+	{
+	    p = (POOL *)malloc( sizeof( POOL ) );
+	    memset( (char *)p, '\0', sizeof( *p ) );
+	    p->name = newstr( name );
+	    p->next = pools;
+	    pools = p;
+	}
+
+	p->limit = limit > 0 ? limit : 1;
+}
+
+/*
+ * make1findpool() - find the declared pool a target's $(JOBPOOL) names
+ */
+
+static POOL *
+make1findpool( TARGET *t )
+{
+	POOL *p;
+
+	if( t->jobpool )
+	    for( p = pools; p; p = p->next )
+		if( !strcmp( p->name, t->jobpool ) )
+		    return p;
+
+	return 0;
+}
+
+/*
+ * make1take() - take a slot in a target's job pool, or wait for one
+ *
+ * Returns 0 if the pool is full, having set the target aside until
+ * make1give() frees a slot.  Targets in no (declared) pool always go.
+ */
+
+static int
+make1take( TARGET *t )
+{
+	POOL *p = make1findpool( t );
+
+	if( !p )
+	    return 1;
+
+	if( p->running < p->limit )
+	{
+	    p->running++;
+	    return 1;
+	}
+
+	if( p->nwaiting == p->size )
+	{
+	    p->size = p->size ? p->size * 2 : 16;
+	    p->waiting = (TARGET **)realloc( (char *)p->waiting,
+				p->size * sizeof( TARGET * ) );
+	}
+
+	p->waiting[ p->nwaiting++ ] = t;
+
+	return 0;
+}
+
+/*
+ * make1give() - give back a slot in a target's job pool
+ *
+ * The most critical target waiting on the pool goes back on the ready
+ * queue to take the slot.
+ */
+
+static void
+make1give( TARGET *t )
+{
+	POOL *p = make1findpool( t );
+	int i, best = 0;
+
+	if( !p )
+	    return;
+
+	p->running--;
+
+	if( !p->nwaiting )
+	    return;
+
+	for( i = 1; i < p->nwaiting; i++ )
+	    if( TARGET_BEFORE( p->waiting[i], p->waiting[ best ] ) )
+		best = i;
+
+	make1push( p->waiting[ best ] );
+	p->waiting[ best ] = p->waiting[ --p->nwaiting ];
+}
+
+/*
+ * make1room() - see if there's memory under -m for a target's command
+ *
+ * Returns 1, having counted the command's expected peak as in use,
+ * if it fits alongside the commands running (or none are running).
+ * Otherwise returns 0; it's for the caller to put the target back.
+ */
+
+static int
+make1room(
+	TARGET	*t,
+	CMD	*cmd )
+{
+	LIST	*targets = lol_get( &cmd->args, 0 );
+	long	need;
+
+	if( !globs.maxmem || globs.noexec || !targets )
+	    return 1;
+
+	need = history_rss( cmd->rule->name, targets->string );
+
+	if( memused && memused + need > globs.maxmem )
+	{
+	    if( DEBUG_EXECCMD )
+		printf( "%s %s: %ldK won't fit in %ldK free\n", 
+		    cmd->rule->name, targets->string,
+		    need, globs.maxmem - memused );
+
+	    return 0;
+	}
+
+	cmd->rss = need;
+	memused += need;
+
+	return 1;
+}
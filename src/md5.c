@@ -0,0 +1,270 @@
+/*
+ * Copyright 1993-2002 Christopher Seiwald and Perforce Software, Inc.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * md5.c - RSA Data Security, Inc. MD5 Message-Digest Algorithm (RFC 1321)
+ *
+ * Written from the RFC; 32 bit words are kept in unsigned longs and
+ * masked, so that this works wherever a long is at least 32 bits.
+ *
+ * External routines:
+ *
+ *	md5_init() - start a new digest
+ *	md5_update() - feed more data into a digest
+ *	md5_final() - finish a digest, yielding its 16 bytes
+ *	md5_file() - digest the contents of a file
+ *	md5_hex() - format a digest in hex
+ *
+ * Internal routines:
+ *
+ *	md5_block() - hash one 64 byte block into the state
+ */
+
+# include "jam.h"
+# include "md5.h"
+
+# define M32( x )	( (x) & 0xffffffffUL )
+# define ROTL( x, n )	M32( ( (x) << (n) ) | ( M32( x ) >> ( 32 - (n) ) ) )
+
+# define F( x, y, z )	( ( (x) & (y) ) | ( ~(x) & (z) ) )
+# define G( x, y, z )	( ( (x) & (z) ) | ( (y) & ~(z) ) )
+# define H( x, y, z )	( (x) ^ (y) ^ (z) )
+# define I( x, y, z )	( (y) ^ ( (x) | M32( ~(z) ) ) )
+
+# define STEP( f, a, b, c, d, x, s, t ) \
+	a = M32( (a) + f( b, c, d ) + (x) + (t) ); \
+	a = M32( ROTL( a, s ) + (b) );
+
+static void md5_block( unsigned long state[4], const unsigned char *p );
+
+/*
+ * md5_init() - start a new digest
+ */
+
+void
+md5_init( MD5CTX *ctx )
+{
+	ctx->state[0] = 0x67452301UL;
+	ctx->state[1] = 0xefcdab89UL;
+	ctx->state[2] = 0x98badcfeUL;
+	ctx->state[3] = 0x10325476UL;
+	ctx->count[0] = ctx->count[1] = 0;
+}
+
+/*
+ * md5_update() - feed more data into a digest
+ */
+
+void
+md5_update(
+	MD5CTX		*ctx,
+	const void	*data,
+	unsigned int	len )
+{
+	const unsigned char *p = (const unsigned char *)data;
+	unsigned int have = ( ctx->count[0] >> 3 ) & 63;
+	unsigned long bits = M32( (unsigned long)len << 3 );
+
+	/* Count bits, carrying into the high word. */
+
+	if( ( ctx->count[0] = M32( ctx->count[0] + bits ) ) < bits )
+	    ctx->count[1]++;
+	ctx->count[1] = M32( ctx->count[1] + ( (unsigned long)len >> 29 ) );
+
+	/* Top up a partial block first. */
+
+	if( have )
+	{
+	    unsigned int need = 64 - have;
+
+	    if( len < need )
+	    {
+		memcpy( ctx->buf + have, p, len );
+		return;
+	    }
+
+	    memcpy( ctx->buf + have, p, need );
+	    md5_block( ctx->state, ctx->buf );
+	    p += need;
+	    len -= need;
+	}
+
+	for( ; len >= 64; p += 64, len -= 64 )
+	    md5_block( ctx->state, p );
+
+	memcpy( ctx->buf, p, len );
+}
+
+/*
+ * md5_final() - finish a digest, yielding its 16 bytes
+ */
+
+void
+md5_final(
+	unsigned char	digest[ MD5_SIZE ],
+	MD5CTX		*ctx )
+{
+	static unsigned char pad[64] = { 0x80 };
+	unsigned char bits[8];
+	unsigned int have = ( ctx->count[0] >> 3 ) & 63;
+	int i;
+
+	for( i = 0; i < 8; i++ )
+	    bits[i] = (unsigned char)( ctx->count[ i / 4 ] >> ( 8 * ( i % 4 ) ) );
+
+	/* Pad to 56 mod 64, then append the length. */
+
+	md5_update( ctx, pad, have < 56 ? 56 - have : 120 - have );
+	md5_update( ctx, bits, 8 );
+
+	for( i = 0; i < MD5_SIZE; i++ )
+	    digest[i] = (unsigned char)( ctx->state[ i / 4 ] >> ( 8 * ( i % 4 ) ) );
+
+	memset( (char *)ctx, 0, sizeof( *ctx ) );
+}
+
+/*
+ * md5_file() - digest the contents of a file
+ *
+ * Returns -1 if the file can't be read.
+ */
+
+int
+md5_file(
+	const char	*path,
+	unsigned char	digest[ MD5_SIZE ] )
+{
+	FILE	*f = fopen( path, "rb" );
+	char	buf[ 8192 ];
+	MD5CTX	ctx[1];
+	int	n, err;
+
+	if( !f )
+	    return -1;
+
+	md5_init( ctx );
+
+	while( ( n = fread( buf, 1, sizeof( buf ), f ) ) > 0 )
+	    md5_update( ctx, buf, n );
+
+	err = ferror( f );
+	fclose( f );
+	md5_final( digest, ctx );
+
+	return err ? -1 : 0;
+}
+
+/*
+ * md5_hex() - format a digest in hex
+ */
+
+void
+md5_hex(
+	char		hex[ 2 * MD5_SIZE + 1 ],
+	unsigned char	digest[ MD5_SIZE ] )
+{
+	static const char digits[] = "0123456789abcdef";
+	int i;
+
+	for( i = 0; i < MD5_SIZE; i++ )
+	{
+	    *hex++ = digits[ digest[i] >> 4 ];
+	    *hex++ = digits[ digest[i] & 15 ];
+	}
+
+	*hex = 0;
+}
+
+/*
+ * md5_block() - hash one 64 byte block into the state
+ */
+
+static void
+md5_block(
+	unsigned long		state[4],
+	const unsigned char	*p )
+{
+	unsigned long a = state[0], b = state[1], c = state[2], d = state[3];
+	unsigned long x[16];
+	int i;
+
+	for( i = 0; i < 16; i++, p += 4 )
+	    x[i] = (unsigned long)p[0] | ( (unsigned long)p[1] << 8 ) |
+		( (unsigned long)p[2] << 16 ) | ( (unsigned long)p[3] << 24 );
+
+	STEP( F, a, b, c, d, x[ 0],  7, 0xd76aa478UL )
+	STEP( F, d, a, b, c, x[ 1], 12, 0xe8c7b756UL )
+	STEP( F, c, d, a, b, x[ 2], 17, 0x242070dbUL )
+	STEP( F, b, c, d, a, x[ 3], 22, 0xc1bdceeeUL )
+	STEP( F, a, b, c, d, x[ 4],  7, 0xf57c0fafUL )
+	STEP( F, d, a, b, c, x[ 5], 12, 0x4787c62aUL )
+	STEP( F, c, d, a, b, x[ 6], 17, 0xa8304613UL )
+	STEP( F, b, c, d, a, x[ 7], 22, 0xfd469501UL )
+	STEP( F, a, b, c, d, x[ 8],  7, 0x698098d8UL )
+	STEP( F, d, a, b, c, x[ 9], 12, 0x8b44f7afUL )
+	STEP( F, c, d, a, b, x[10], 17, 0xffff5bb1UL )
+	STEP( F, b, c, d, a, x[11], 22, 0x895cd7beUL )
+	STEP( F, a, b, c, d, x[12],  7, 0x6b901122UL )
+	STEP( F, d, a, b, c, x[13], 12, 0xfd987193UL )
+	STEP( F, c, d, a, b, x[14], 17, 0xa679438eUL )
+	STEP( F, b, c, d, a, x[15], 22, 0x49b40821UL )
+
+	STEP( G, a, b, c, d, x[ 1],  5, 0xf61e2562UL )
+	STEP( G, d, a, b, c, x[ 6],  9, 0xc040b340UL )
+	STEP( G, c, d, a, b, x[11], 14, 0x265e5a51UL )
+	STEP( G, b, c, d, a, x[ 0], 20, 0xe9b6c7aaUL )
+	STEP( G, a, b, c, d, x[ 5],  5, 0xd62f105dUL )
+	STEP( G, d, a, b, c, x[10],  9, 0x02441453UL )
+	STEP( G, c, d, a, b, x[15], 14, 0xd8a1e681UL )
+	STEP( G, b, c, d, a, x[ 4], 20, 0xe7d3fbc8UL )
+	STEP( G, a, b, c, d, x[ 9],  5, 0x21e1cde6UL )
+	STEP( G, d, a, b, c, x[14],  9, 0xc33707d6UL )
+	STEP( G, c, d, a, b, x[ 3], 14, 0xf4d50d87UL )
+	STEP( G, b, c, d, a, x[ 8], 20, 0x455a14edUL )
+	STEP( G, a, b, c, d, x[13],  5, 0xa9e3e905UL )
+	STEP( G, d, a, b, c, x[ 2],  9, 0xfcefa3f8UL )
+	STEP( G, c, d, a, b, x[ 7], 14, 0x676f02d9UL )
+	STEP( G, b, c, d, a, x[12], 20, 0x8d2a4c8aUL )
+
+	STEP( H, a, b, c, d, x[ 5],  4, 0xfffa3942UL )
+	STEP( H, d, a, b, c, x[ 8], 11, 0x8771f681UL )
+	STEP( H, c, d, a, b, x[11], 16, 0x6d9d6122UL )
+	STEP( H, b, c, d, a, x[14], 23, 0xfde5380cUL )
+	STEP( H, a, b, c, d, x[ 1],  4, 0xa4beea44UL )
+	STEP( H, d, a, b, c, x[ 4], 11, 0x4bdecfa9UL )
+	STEP( H, c, d, a, b, x[ 7], 16, 0xf6bb4b60UL )
+	STEP( H, b, c, d, a, x[10], 23, 0xbebfbc70UL )
+	STEP( H, a, b, c, d, x[13],  4, 0x289b7ec6UL )
+	STEP( H, d, a, b, c, x[ 0], 11, 0xeaa127faUL )
+	STEP( H, c, d, a, b, x[ 3], 16, 0xd4ef3085UL )
+	STEP( H, b, c, d, a, x[ 6], 23, 0x04881d05UL )
+	STEP( H, a, b, c, d, x[ 9],  4, 0xd9d4d039UL )
+	STEP( H, d, a, b, c, x[12], 11, 0xe6db99e5UL )
+	STEP( H, c, d, a, b, x[15], 16, 0x1fa27cf8UL )
+	STEP( H, b, c, d, a, x[ 2], 23, 0xc4ac5665UL )
+
+	STEP( I, a, b, c, d, x[ 0],  6, 0xf4292244UL )
+	STEP( I, d, a, b, c, x[ 7], 10, 0x432aff97UL )
+	STEP( I, c, d, a, b, x[14], 15, 0xab9423a7UL )
+	STEP( I, b, c, d, a, x[ 5], 21, 0xfc93a039UL )
+	STEP( I, a, b, c, d, x[12],  6, 0x655b59c3UL )
+	STEP( I, d, a, b, c, x[ 3], 10, 0x8f0ccc92UL )
+	STEP( I, c, d, a, b, x[10], 15, 0xffeff47dUL )
+	STEP( I, b, c, d, a, x[ 1], 21, 0x85845dd1UL )
+	STEP( I, a, b, c, d, x[ 8],  6, 0x6fa87e4fUL )
+	STEP( I, d, a, b, c, x[15], 10, 0xfe2ce6e0UL )
+	STEP( I, c, d, a, b, x[ 6], 15, 0xa3014314UL )
+	STEP( I, b, c, d, a, x[13], 21, 0x4e0811a1UL )
+	STEP( I, a, b, c, d, x[ 4],  6, 0xf7537e82UL )
+	STEP( I, d, a, b, c, x[11], 10, 0xbd3af235UL )
+	STEP( I, c, d, a, b, x[ 2], 15, 0x2ad7d2bbUL )
+	STEP( I, b, c, d, a, x[ 9], 21, 0xeb86d391UL )
+
+	state[0] = M32( state[0] + a );
+	state[1] = M32( state[1] + b );
+	state[2] = M32( state[2] + c );
+	state[3] = M32( state[3] + d );
+}
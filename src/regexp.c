@@ -38,6 +38,9 @@
  *** seiwald@perforce.com, on 20 January 2000, to use function prototypes.
  *** THIS IS AN ALTERED VERSION.  It was altered by Christopher Seiwald
  *** seiwald@perforce.com, on 05 November 2002, to const string literals.
+ *** THIS IS AN ALTERED VERSION.  Regexec() no longer backtracks, but
+ *** runs a lazily built DFA and a Pike VM translated from the program,
+ *** kept with the program so free() still frees it all.
  *
  * Beware that some of this code is subtly aware of the way operator
  * precedence is structured in regular expressions.  Serious changes in
@@ -60,6 +63,7 @@
  * reganch	is the match anchored (at beginning-of-line only)?
  * regmust	string (pointer into program) that match must include, or NULL
  * regmlen	length of regmust string
+ * regvm	the machine regexec() runs, after the program (see regexec())
  *
  * Regstart and reganch permit very fast decisions on suitable starting points
  * for a match, cutting down the work a lot.  Regmust permits fast rejection
@@ -192,6 +196,7 @@ STATIC void regc( int b );
 STATIC void reginsert( char op, char *opnd );
 STATIC void regtail( char *p, char *val );
 STATIC void regoptail( char *p, char *val );
+STATIC regexp *regvmcomp( regexp *r );
 #ifdef STRCSPN
 STATIC int strcspn();
 #endif
@@ -252,6 +257,10 @@ regcomp( const char *exp )
 	if (reg(0, &flags) == NULL)
 		return(NULL);
 
+	/* Add the machine regexec() runs. */
+	if ((r = regvmcomp(r)) == NULL)
+		FAIL("out of space");
+
 	/* Dig out information for optimizations. */
 	r->regstart = '\0';	/* Worst-case defaults. */
 	r->reganch = 0;
@@ -291,6 +300,40 @@ regcomp( const char *exp )
 	return(r);
 }
 
+/*
+ - regliteral - longest literal string any match must include
+ *
+ * Unlike regmust, found even where regexec() wouldn't bother using it,
+ * for callers that can skip over whole lines of text not containing it.
+ * Sets *s to the string (not null terminated) and returns its length,
+ * or 0 if there's no such string.
+ */
+int
+regliteral(
+	regexp *prog,
+	const char **s )
+{
+	register char *scan;
+	int len = 0;
+
+	if (prog->regmust != NULL) {
+		*s = prog->regmust;
+		return(prog->regmlen);
+	}
+
+	scan = prog->program+1;			/* First BRANCH. */
+	if (OP(regnext(scan)) != END)		/* Alternatives: no telling. */
+		return(0);
+
+	for (scan = OPERAND(scan); scan != NULL; scan = regnext(scan))
+		if (OP(scan) == EXACTLY && strlen(OPERAND(scan)) >= len) {
+			*s = OPERAND(scan);
+			len = strlen(OPERAND(scan));
+		}
+
+	return(len);
+}
+
 /*
  - reg - regular expression, i.e. main body or parenthesized thing
  *
@@ -764,25 +807,127 @@ regoptail(
 
 /*
  * regexec and friends
+ *
+ * regexec() doesn't interpret the program directly: trying each BRANCH
+ * in turn, and backing up after STAR and PLUS, can take time exponential
+ * in the length of the string.  Instead regcomp() has regvmcomp()
+ * translate the program into a few simpler instructions, for a Thompson
+ * NFA that looks at each character of the string only once:
+ *
+ * I_CLASS	consume a character in set, go to x
+ * I_MATCH	success
+ * I_JMP	go to x
+ * I_SPLIT	go to x, or failing that y
+ * I_SAVE	note this point in input as startp/endp slot y, go to x
+ * I_BOL ...	go to x, if "" matches here as BOL (EOL, WORDA, WORDZ) would
+ *
+ * Whether there's a match at all is found by regdfa(), a DFA whose
+ * states (the instructions the NFA could go on from) are made only as
+ * they're first needed, and kept with the regexp for later calls.  Only
+ * for a string that matches does regpike() run the NFA as a Pike VM,
+ * to find startp[] and endp[]: it keeps a thread for each instruction
+ * the NFA could be at, in the order backtracking would have tried them,
+ * so what it finds is just what backtracking would have.
+ *
+ * All this goes in the one piece of memory with the program, so free()
+ * still frees it all.  DFA states go in an arena of REGDFASIZE bytes,
+ * emptied when it fills; a string needing too many states is left to
+ * regpike() alone.  A regexp's machine is its own, so like
+ * startp[] and endp[] a regexp must be used by one thread at a time.
+ */
+
+#define	I_CLASS	0
+#define	I_MATCH	1
+#define	I_JMP	2
+#define	I_SPLIT	3
+#define	I_SAVE	4
+#define	I_BOL	5
+#define	I_EOL	6
+#define	I_WORDA	7
+#define	I_WORDZ	8
+
+struct reginst {
+	int op;
+	int x;
+	int y;
+	unsigned char set[32];	/* I_CLASS: a bit per character */
+};
+
+#define	INSET(s, c)	((s)[(c) >> 3] & (1 << ((c) & 7)))
+#define	ADDSET(s, c)	((s)[(c) >> 3] |= (1 << ((c) & 7)))
+#define	ISWORD(c)	(isalnum(c) || (c) == '_')
+
+/*
+ * A DFA state: the instructions the NFA goes on from, before following
+ * any I_JMP, I_SPLIT, etc; and what's known of the previous character,
+ * for the "" matches.  next[] is by class of the next character (see
+ * cls[] below), filled in as each is needed.
  */
+struct regdstate {
+	struct regdstate *chain;	/* Next in hash bucket. */
+	int flags;
+	int n;
+	int *k;				/* n instructions, ascending */
+	struct regdstate **next;
+};
+
+#define	DS_BOL	01		/* At beginning of string. */
+#define	DS_WORD	02		/* Previous character a word character. */
+
+static struct regdstate regdmatch;	/* next[] for "matched here" */
+static struct regdstate regddead;	/* next[] for "no match" */
+
+#define	REGDFASIZE	32768
+#define	REGDHASH	64
+#define	REGDFLUSHES	2	/* In one regexec(), before giving up on it. */
+
+struct regvm {
+	int ninst;
+	struct reginst *inst;
+	int start;			/* First instruction. */
+	int nslot;			/* Slots used: 2 * (1 + number of ()s) */
+	int ncls;
+	unsigned char cls[256];		/* Characters no instruction tells apart */
+					/* ...are in the same class. */
+	int *mark;			/* For closures: gen when last seen. */
+	int gen;
+	int *work;			/* 4 * ninst ints of scratch */
+	int *tpc[2];			/* Pike VM threads: instruction, */
+	const char **tcap[2];		/* ...and nslot slots. */
+	struct regdstate *dstart;
+	struct regdstate *dhash[REGDHASH];
+	char *arena;
+	long used;
+	long flushes;
+};
 
 /*
- * Global work variables for regexec().
+ * Work variables for regpike()'s regadd().
  */
-static const char *reginput;	/* String-input pointer. */
-static char *regbol;		/* Beginning of input, for ^ check. */
-static const char **regstartp;	/* Pointer to startp array. */
-static const char **regendp;	/* Ditto for endp. */
+struct regpike {
+	struct regvm *vm;
+	const char *bol;	/* Beginning of input, for ^ check. */
+	const char *input;	/* Where threads are being added. */
+	const char **cap;	/* Slots of thread being added. */
+	int gen;
+};
+
+#define	REGALIGN(n)	(((n) + 7) & ~7L)
 
 /*
  * Forwards.
  */
-STATIC int regtry( regexp *prog, const char *string );
-STATIC int regmatch( char *prog );
-STATIC int regrepeat( char *p );
+STATIC char *regskip( char *p );
+STATIC void regset( struct reginst *in, char *p );
+STATIC void regrefine( struct regvm *vm, unsigned char *set );
+STATIC int regnewgen( struct regvm *vm );
+STATIC int regdfa( regexp *prog, const char *string );
+STATIC struct regdstate *regdstep( regexp *prog, struct regdstate *d, int c );
+STATIC struct regdstate *regdfind( struct regvm *vm, int *k, int n, int flags );
+STATIC int regpike( regexp *prog, const char *string );
+STATIC int regadd( struct regpike *rp, int *pc, const char **caps, int n, int i );
 
 #ifdef DEBUG
-int regnarrate = 0;
 void regdump();
 STATIC char *regprop();
 #endif
@@ -821,314 +966,631 @@ regexec(
 			return(0);
 	}
 
-	/* Mark beginning of line for ^ . */
-	regbol = (char *)string;
-
-	/* Simplest case:  anchored match need be tried only once. */
-	if (prog->reganch)
-		return(regtry(prog, string));
-
-	/* Messy cases:  unanchored match. */
-	s = (char *)string;
-	if (prog->regstart != '\0')
-		/* We know what char it must start with. */
-		while ((s = strchr(s, prog->regstart)) != NULL) {
-			if (regtry(prog, s))
-				return(1);
-			s++;
-		}
-	else
-		/* We don't -- general case. */
-		do {
-			if (regtry(prog, s))
-				return(1);
-		} while (*s++ != '\0');
-
-	/* Failure. */
-	return(0);
-}
-
-/*
- - regtry - try match at specific point
- */
-static int			/* 0 failure, 1 success */
-regtry(
-	regexp *prog,
-	const char *string )
-{
-	register int i;
-	register const char **sp;
-	register const char **ep;
-
-	reginput = string;
-	regstartp = prog->startp;
-	regendp = prog->endp;
-
-	sp = prog->startp;
-	ep = prog->endp;
-	for (i = NSUBEXP; i > 0; i--) {
-		*sp++ = NULL;
-		*ep++ = NULL;
-	}
-	if (regmatch(prog->program + 1)) {
-		prog->startp[0] = string;
-		prog->endp[0] = reginput;
-		return(1);
-	} else
+	/* Any match at all?  (-1 is "can't tell".) */
+	if (regdfa(prog, string) == 0)
 		return(0);
+
+	/* Where, and its subexpressions. */
+	return(regpike(prog, string));
 }
 
 /*
- - regmatch - main matching routine
+ - regvmcomp - add the machine regexec() runs to a compiled regexp
  *
- * Conceptually the strategy is simple:  check to see whether the current
- * node matches, call self recursively to see whether the rest matches,
- * and then act accordingly.  In practice we make some effort to avoid
- * recursion, in particular by going through "ordinary" nodes (that don't
- * need to know whether the rest of the match failed) by a loop instead of
- * by recursion.
+ * Returns the regexp, reallocated to hold it, or NULL (and the regexp
+ * freed) if there's no room.
  */
-static int			/* 0 failure, 1 success */
-regmatch( char *prog )
+static regexp *
+regvmcomp( regexp *r )
 {
-	register char *scan;	/* Current node. */
-	char *next;		/* Next node. */
+	register char *p;
+	register struct regvm *vm;
+	register struct reginst *in;
+	regexp *nr;
+	char *s, *next;
+	int *map;
+	int ninst = 0;
+	int i, x, op, c;
+	long off, size;
+	unsigned char set[32];
+
+	/* Where each node's instructions go.  STAR and PLUS take their */
+	/* operand along, for 2; EXACTLY takes one per character. */
+	if ((map = (int *)malloc(regsize * sizeof(int))) == NULL) {
+		free((char *)r);
+		return(NULL);
+	}
 
-	scan = prog;
-#ifdef DEBUG
-	if (scan != NULL && regnarrate)
-		fprintf(stderr, "%s(\n", regprop(scan));
-#endif
-	while (scan != NULL) {
-#ifdef DEBUG
-		if (regnarrate)
-			fprintf(stderr, "%s...\n", regprop(scan));
-#endif
-		next = regnext(scan);
+	for (p = r->program + 1; ; p = regskip(p)) {
+		map[p - r->program] = ninst;
+		op = OP(p);
+		if (op == STAR || op == PLUS) {
+			ninst += 2;
+			p = OPERAND(p);
+		} else if (op == EXACTLY)
+			ninst += strlen(OPERAND(p));
+		else
+			ninst++;
+		if (op == END)
+			break;
+	}
 
-		switch (OP(scan)) {
+	/* Room for it all, after the program. */
+	off = REGALIGN(sizeof(regexp) + regsize);
+	size = off + REGALIGN(sizeof(struct regvm)) +
+		REGALIGN(ninst * sizeof(struct reginst)) +
+		REGALIGN(ninst * sizeof(int)) +
+		REGALIGN(4 * ninst * sizeof(int)) +
+		2 * REGALIGN(ninst * sizeof(int)) +
+		2 * REGALIGN(ninst * 2 * regnpar * sizeof(char *)) +
+		REGDFASIZE;
+
+	if ((nr = (regexp *)realloc((char *)r, size)) == NULL) {
+		free((char *)r);
+		free((char *)map);
+		return(NULL);
+	}
+	r = nr;
+
+	s = (char *)r + off;
+	r->regvm = vm = (struct regvm *)s;
+	memset(s, 0, size - off - REGDFASIZE);
+	s += REGALIGN(sizeof(struct regvm));
+	vm->inst = (struct reginst *)s;
+	s += REGALIGN(ninst * sizeof(struct reginst));
+	vm->mark = (int *)s;
+	s += REGALIGN(ninst * sizeof(int));
+	vm->work = (int *)s;
+	s += REGALIGN(4 * ninst * sizeof(int));
+	for (i = 0; i < 2; i++) {
+		vm->tpc[i] = (int *)s;
+		s += REGALIGN(ninst * sizeof(int));
+		vm->tcap[i] = (const char **)s;
+		s += REGALIGN(ninst * 2 * regnpar * sizeof(char *));
+	}
+	vm->arena = s;
+	vm->ninst = ninst;
+	vm->nslot = 2 * regnpar;
+	vm->start = map[1];
+
+	/* Translate each node. */
+	for (p = r->program + 1; ; p = regskip(p)) {
+		i = map[p - r->program];
+		in = vm->inst + i;
+		op = OP(p);
+		next = regnext(p);
+		x = next != NULL ? map[next - r->program] : -1;
+
+		switch (op) {
+		case END:
+			in->op = I_MATCH;
+			break;
 		case BOL:
-			if (reginput != regbol)
-				return(0);
+			in->op = I_BOL;
+			in->x = x;
 			break;
 		case EOL:
-			if (*reginput != '\0')
-				return(0);
+			in->op = I_EOL;
+			in->x = x;
 			break;
 		case WORDA:
-			/* Must be looking at a letter, digit, or _ */
-			if ((!isalnum(*reginput)) && *reginput != '_')
-				return(0);
-			/* Prev must be BOL or nonword */
-			if (reginput > regbol &&
-			    (isalnum(reginput[-1]) || reginput[-1] == '_'))
-				return(0);
+			in->op = I_WORDA;
+			in->x = x;
 			break;
 		case WORDZ:
-			/* Must be looking at non letter, digit, or _ */
-			if (isalnum(*reginput) || *reginput == '_')
-				return(0);
-			/* We don't care what the previous char was */
+			in->op = I_WORDZ;
+			in->x = x;
 			break;
 		case ANY:
-			if (*reginput == '\0')
-				return(0);
-			reginput++;
+		case ANYOF:
+		case ANYBUT:
+			regset(in, p);
+			in->x = x;
 			break;
-		case EXACTLY: {
-				register int len;
-				register char *opnd;
-
-				opnd = OPERAND(scan);
-				/* Inline the first character, for speed. */
-				if (*opnd != *reginput)
-					return(0);
-				len = strlen(opnd);
-				if (len > 1 && strncmp(opnd, reginput, len) != 0)
-					return(0);
-				reginput += len;
+		case EXACTLY:
+			for (s = OPERAND(p); *s != '\0'; s++, in++, i++) {
+				in->op = I_CLASS;
+				ADDSET(in->set, UCHARAT(s));
+				in->x = s[1] != '\0' ? i + 1 : x;
 			}
 			break;
-		case ANYOF:
- 			if (*reginput == '\0' || strchr(OPERAND(scan), *reginput) == NULL)
-				return(0);
-			reginput++;
-			break;
-		case ANYBUT:
- 			if (*reginput == '\0' || strchr(OPERAND(scan), *reginput) != NULL)
-				return(0);
-			reginput++;
+		case BRANCH:
+			/* Only a choice if another BRANCH follows. */
+			in->x = map[OPERAND(p) - r->program];
+			if (next != NULL && OP(next) == BRANCH) {
+				in->op = I_SPLIT;
+				in->y = x;
+			} else
+				in->op = I_JMP;
 			break;
+		case BACK:
 		case NOTHING:
+			in->op = I_JMP;
+			in->x = x;
 			break;
-		case BACK:
+		case STAR:
+			/* Operand as often as possible, then on. */
+			in[0].op = I_SPLIT;
+			in[0].x = i + 1;
+			in[0].y = x;
+			regset(&in[1], OPERAND(p));
+			in[1].x = i;
+			p = OPERAND(p);
 			break;
-		case OPEN+1:
-		case OPEN+2:
-		case OPEN+3:
-		case OPEN+4:
-		case OPEN+5:
-		case OPEN+6:
-		case OPEN+7:
-		case OPEN+8:
-		case OPEN+9: {
-				register int no;
-				register const char *save;
-
-				no = OP(scan) - OPEN;
-				save = reginput;
-
-				if (regmatch(next)) {
-					/*
-					 * Don't set startp if some later
-					 * invocation of the same parentheses
-					 * already has.
-					 */
-					if (regstartp[no] == NULL)
-						regstartp[no] = save;
-					return(1);
-				} else
-					return(0);
-			}
+		case PLUS:
+			/* Operand, then as STAR. */
+			regset(&in[0], OPERAND(p));
+			in[0].x = i + 1;
+			in[1].op = I_SPLIT;
+			in[1].x = i;
+			in[1].y = x;
+			p = OPERAND(p);
 			break;
-		case CLOSE+1:
-		case CLOSE+2:
-		case CLOSE+3:
-		case CLOSE+4:
-		case CLOSE+5:
-		case CLOSE+6:
-		case CLOSE+7:
-		case CLOSE+8:
-		case CLOSE+9: {
-				register int no;
-				register const char *save;
-
-				no = OP(scan) - CLOSE;
-				save = reginput;
-
-				if (regmatch(next)) {
-					/*
-					 * Don't set endp if some later
-					 * invocation of the same parentheses
-					 * already has.
-					 */
-					if (regendp[no] == NULL)
-						regendp[no] = save;
-					return(1);
-				} else
-					return(0);
-			}
+		default:
+			/* OPEN+n and CLOSE+n. */
+			in->op = I_SAVE;
+			in->x = x;
+			in->y = op >= CLOSE ? 2 * (op - CLOSE) + 1 : 2 * (op - OPEN);
 			break;
-		case BRANCH: {
-				register const char *save;
-
-				if (OP(next) != BRANCH)		/* No choice. */
-					next = OPERAND(scan);	/* Avoid recursion. */
-				else {
-					do {
-						save = reginput;
-						if (regmatch(OPERAND(scan)))
-							return(1);
-						reginput = save;
-						scan = regnext(scan);
-					} while (scan != NULL && OP(scan) == BRANCH);
-					return(0);
-					/* NOTREACHED */
-				}
-			}
+		}
+		if (op == END)
 			break;
-		case STAR:
-		case PLUS: {
-				register char nextch;
-				register int no;
-				register const char *save;
-				register int min;
-
-				/*
-				 * Lookahead to avoid useless match attempts
-				 * when we know what character comes next.
-				 */
-				nextch = '\0';
-				if (OP(next) == EXACTLY)
-					nextch = *OPERAND(next);
-				min = (OP(scan) == STAR) ? 0 : 1;
-				save = reginput;
-				no = regrepeat(OPERAND(scan));
-				while (no >= min) {
-					/* If it could work, try it. */
-					if (nextch == '\0' || *reginput == nextch)
-						if (regmatch(next))
-							return(1);
-					/* Couldn't or didn't -- back up. */
-					no--;
-					reginput = save + no;
-				}
-				return(0);
-			}
+	}
+
+	free((char *)map);
+
+	/* Classes of characters: '\0', word characters, and those that */
+	/* each I_CLASS tells apart. */
+	vm->ncls = 1;
+	memset(set, 0, sizeof(set));
+	ADDSET(set, 0);
+	regrefine(vm, set);
+	memset(set, 0, sizeof(set));
+	for (c = 1; c < 256; c++)
+		if (ISWORD(c))
+			ADDSET(set, c);
+	regrefine(vm, set);
+	for (i = 0; i < ninst; i++)
+		if (vm->inst[i].op == I_CLASS)
+			regrefine(vm, vm->inst[i].set);
+
+	return(r);
+}
+
+/*
+ - regskip - the node after this one, in the program as laid out
+ */
+static char *
+regskip( register char *p )
+{
+	register char op = OP(p);
+
+	p = OPERAND(p);
+	if (op == ANYOF || op == ANYBUT || op == EXACTLY)
+		p += strlen(p) + 1;
+	return(p);
+}
+
+/*
+ - regset - make an I_CLASS of the characters a simple node matches
+ *
+ * Never '\0', which ends the input.
+ */
+static void
+regset(
+	register struct reginst *in,
+	char *p )
+{
+	register int c;
+
+	in->op = I_CLASS;
+	memset(in->set, 0, sizeof(in->set));
+
+	for (c = 1; c < 256; c++)
+		switch (OP(p)) {
+		case ANY:
+			ADDSET(in->set, c);
 			break;
-		case END:
-			return(1);	/* Success! */
+		case EXACTLY:
+			if (c == UCHARAT(OPERAND(p)))
+				ADDSET(in->set, c);
 			break;
-		default:
-			regerror("memory corruption");
-			return(0);
+		case ANYOF:
+			if (strchr(OPERAND(p), c) != NULL)
+				ADDSET(in->set, c);
+			break;
+		case ANYBUT:
+			if (strchr(OPERAND(p), c) == NULL)
+				ADDSET(in->set, c);
 			break;
 		}
+}
 
-		scan = next;
+/*
+ - regrefine - split the classes of characters by a set
+ */
+static void
+regrefine(
+	register struct regvm *vm,
+	unsigned char *set )
+{
+	int renum[ 2 * 256 ];
+	register int c, k;
+	int n = 0;
+
+	for (k = 0; k < 2 * vm->ncls; k++)
+		renum[k] = -1;
+
+	for (c = 0; c < 256; c++) {
+		k = 2 * vm->cls[c] + (INSET(set, c) != 0);
+		if (renum[k] < 0)
+			renum[k] = n++;
+		vm->cls[c] = renum[k];
 	}
 
-	/*
-	 * We get here only if there's trouble -- normally "case END" is
-	 * the terminating point.
-	 */
-	regerror("corrupted pointers");
-	return(0);
+	vm->ncls = n;
 }
 
 /*
- - regrepeat - repeatedly match something simple, report how many
+ - regnewgen - a new generation of marks, for a new closure
  */
 static int
-regrepeat( char *p )
+regnewgen( register struct regvm *vm )
 {
-	register int count = 0;
-	register const char *scan;
-	register char *opnd;
+	if (++vm->gen <= 0) {
+		memset((char *)vm->mark, 0, vm->ninst * sizeof(int));
+		vm->gen = 1;
+	}
+	return(vm->gen);
+}
 
-	scan = reginput;
-	opnd = OPERAND(p);
-	switch (OP(p)) {
-	case ANY:
-		count = strlen(scan);
-		scan += count;
-		break;
-	case EXACTLY:
-		while (*opnd == *scan) {
-			count++;
-			scan++;
+/*
+ - regdfa - run the DFA over the string: is there a match?
+ *
+ * Returns 1 if so, 0 if not, -1 if its states won't fit in the arena:
+ * if a state doesn't, or if it's emptied more than REGDFLUSHES times.
+ */
+static int
+regdfa(
+	regexp *prog,
+	const char *string )
+{
+	register struct regvm *vm = prog->regvm;
+	register struct regdstate *d, *n;
+	register const char *s;
+	long flushes = vm->flushes;
+	int c;
+
+	if ((d = vm->dstart) == NULL) {
+		vm->work[0] = vm->start;
+		if ((d = vm->dstart = regdfind(vm, vm->work, 1, DS_BOL)) == NULL)
+			return(-1);
+	}
+
+	for (s = string; ; s++) {
+		c = UCHARAT(s);
+		if ((n = d->next[vm->cls[c]]) == NULL &&
+		    ((n = regdstep(prog, d, c)) == NULL ||
+		     vm->flushes > flushes + REGDFLUSHES))
+			return(-1);
+		if (n == &regdmatch)
+			return(1);
+		if (n->n == 0)		/* regddead, or anchored and done. */
+			return(0);
+		d = n;
+	}
+}
+
+/*
+ - regdstep - make the DFA's move from a state on a character
+ */
+static struct regdstate *
+regdstep(
+	regexp *prog,
+	struct regdstate *d,
+	int c )
+{
+	register struct regvm *vm = prog->regvm;
+	register struct reginst *in;
+	register int i;
+	int *stack = vm->work;			/* 3 * ninst */
+	int *k = vm->work + 3 * vm->ninst;	/* ninst */
+	int sp = 0, n = 0, matched = 0;
+	int gen, word, prevword;
+	long flushes = vm->flushes;
+	struct regdstate *t;
+
+	/* Follow the NFA from d's instructions to those that consume c. */
+	/* The kernel of the next state is where they go. */
+	word = ISWORD(c);
+	prevword = d->flags & DS_WORD;
+	gen = regnewgen(vm);
+
+	for (i = d->n; i-- > 0; )
+		stack[sp++] = d->k[i];
+
+	while (sp > 0) {
+		i = stack[--sp];
+		if (vm->mark[i] == gen)
+			continue;
+		vm->mark[i] = gen;
+		in = vm->inst + i;
+
+		switch (in->op) {
+		case I_CLASS:
+			if (c != 0 && INSET(in->set, c))
+				k[n++] = in->x;
+			continue;
+		case I_MATCH:
+			matched = 1;
+			continue;
+		case I_SPLIT:
+			stack[sp++] = in->y;
+			break;
+		case I_BOL:
+			if (!(d->flags & DS_BOL))
+				continue;
+			break;
+		case I_EOL:
+			if (c != 0)
+				continue;
+			break;
+		case I_WORDA:
+			if (!word || prevword)
+				continue;
+			break;
+		case I_WORDZ:
+			if (word)
+				continue;
+			break;
 		}
-		break;
-	case ANYOF:
-		while (*scan != '\0' && strchr(opnd, *scan) != NULL) {
-			count++;
-			scan++;
+		stack[sp++] = in->x;
+	}
+
+	if (matched)
+		t = &regdmatch;
+	else if (c == 0)
+		t = &regddead;
+	else {
+		/* In order, without duplicates, and with a new start */
+		/* (unless it's anchored) to find matches starting later. */
+		gen = regnewgen(vm);
+		for (i = 0; i < n; i++)
+			vm->mark[k[i]] = gen;
+		if (!prog->reganch)
+			vm->mark[vm->start] = gen;
+		for (n = 0, i = 0; i < vm->ninst; i++)
+			if (vm->mark[i] == gen)
+				k[n++] = i;
+		if ((t = regdfind(vm, k, n, word ? DS_WORD : 0)) == NULL)
+			return(NULL);
+	}
+
+	/* Unless the arena was emptied, d is still there to remember it. */
+	if (vm->flushes == flushes)
+		d->next[vm->cls[c]] = t;
+
+	return(t);
+}
+
+/*
+ - regdfind - find or make the DFA state for a kernel
+ *
+ * If the arena's full, it's emptied first; returns NULL if one state
+ * won't fit.
+ */
+static struct regdstate *
+regdfind(
+	register struct regvm *vm,
+	int *k,
+	int n,
+	int flags )
+{
+	register struct regdstate *d;
+	register int i;
+	unsigned long h = flags;
+	long size;
+
+	for (i = 0; i < n; i++)
+		h = h * 33 + k[i];
+	h %= REGDHASH;
+
+	for (d = vm->dhash[h]; d != NULL; d = d->chain)
+		if (d->flags == flags && d->n == n &&
+		    !memcmp((char *)d->k, (char *)k, n * sizeof(int)))
+			return(d);
+
+	size = REGALIGN(sizeof(struct regdstate)) +
+		REGALIGN(vm->ncls * sizeof(struct regdstate *)) +
+		REGALIGN(n * sizeof(int));
+
+	if (size > REGDFASIZE)
+		return(NULL);
+
+	if (vm->used + size > REGDFASIZE) {
+		memset((char *)vm->dhash, 0, sizeof(vm->dhash));
+		vm->dstart = NULL;
+		vm->used = 0;
+		vm->flushes++;
+	}
+
+	d = (struct regdstate *)(vm->arena + vm->used);
+	vm->used += size;
+	d->next = (struct regdstate **)((char *)d +
+		REGALIGN(sizeof(struct regdstate)));
+	d->k = (int *)((char *)d->next +
+		REGALIGN(vm->ncls * sizeof(struct regdstate *)));
+	for (i = 0; i < vm->ncls; i++)
+		d->next[i] = NULL;
+	memcpy((char *)d->k, (char *)k, n * sizeof(int));
+	d->n = n;
+	d->flags = flags;
+	d->chain = vm->dhash[h];
+	vm->dhash[h] = d;
+
+	return(d);
+}
+
+/*
+ - regpike - run the NFA over the string, to find the match
+ *
+ * Threads are kept in priority order: that in which backtracking
+ * would have tried them.  A thread reaching an instruction another
+ * has already reached at the same point in the input is dropped, as
+ * the one before it would have been tried first and done anything it
+ * could do.  A thread reaching I_MATCH wins over those after it.
+ */
+static int
+regpike(
+	regexp *prog,
+	const char *string )
+{
+	register struct regvm *vm = prog->regvm;
+	register struct reginst *in;
+	register int t, c;
+	struct regpike rp[1];
+	const char *cap[2 * NSUBEXP];
+	const char *found[2 * NSUBEXP];
+	int nslot = vm->nslot;
+	int cur = 0, ncur = 0, nnext;
+	int matched = 0;
+	const char *s, *p;
+
+	rp->vm = vm;
+	rp->bol = string;
+	rp->cap = cap;
+	rp->gen = regnewgen(vm);
+
+	for (s = string; ; s++) {
+		/* A new thread starting here, after all the others: */
+		/* matches starting earlier win. */
+		if (!matched && (s == string || !prog->reganch) &&
+		    (prog->regstart == '\0' || *s == prog->regstart)) {
+			for (t = 0; t < nslot; t++)
+				cap[t] = NULL;
+			cap[0] = s;
+			rp->input = s;
+			ncur = regadd(rp, vm->tpc[cur], vm->tcap[cur], ncur, vm->start);
 		}
-		break;
-	case ANYBUT:
-		while (*scan != '\0' && strchr(opnd, *scan) == NULL) {
-			count++;
-			scan++;
+
+		if (ncur == 0) {
+			/* Nothing going: skip to where something might start. */
+			if (matched || prog->reganch || *s == '\0')
+				break;
+			if (prog->regstart != '\0') {
+				if ((p = strchr(s + 1, prog->regstart)) == NULL)
+					break;
+				s = p - 1;
+			}
+			rp->gen = regnewgen(vm);
+			continue;
 		}
-		break;
-	default:		/* Oh dear.  Called inappropriately. */
-		regerror("internal foulup");
-		count = 0;	/* Best compromise. */
-		break;
+
+		/* Each thread, on this character. */
+		c = UCHARAT(s);
+		nnext = 0;
+		rp->gen = regnewgen(vm);
+		rp->input = s + 1;
+
+		for (t = 0; t < ncur; t++) {
+			in = vm->inst + vm->tpc[cur][t];
+			if (in->op == I_MATCH) {
+				matched = 1;
+				memcpy((char *)found, (char *)(vm->tcap[cur] + t * nslot),
+					nslot * sizeof(char *));
+				found[1] = s;
+				break;
+			}
+			if (c != 0 && INSET(in->set, c)) {
+				memcpy((char *)cap, (char *)(vm->tcap[cur] + t * nslot),
+					nslot * sizeof(char *));
+				nnext = regadd(rp, vm->tpc[!cur], vm->tcap[!cur],
+					nnext, in->x);
+			}
+		}
+
+		cur = !cur;
+		ncur = nnext;
+
+		if (c == 0)
+			break;
 	}
-	reginput = scan;
 
-	return(count);
+	if (!matched)
+		return(0);
+
+	for (t = 0; t < NSUBEXP; t++) {
+		prog->startp[t] = 2 * t < nslot ? found[2 * t] : NULL;
+		prog->endp[t] = 2 * t < nslot ? found[2 * t + 1] : NULL;
+	}
+
+	return(1);
+}
+
+/*
+ - regadd - add a thread at an instruction, following I_JMP etc.
+ *
+ * Adds at most one thread for each I_CLASS or I_MATCH it gets to, in
+ * priority order, to pc[] and caps[] after the n already there.  Returns
+ * the new count.
+ */
+static int
+regadd(
+	register struct regpike *rp,
+	int *pc,
+	const char **caps,
+	int n,
+	register int i )
+{
+	register struct regvm *vm = rp->vm;
+	register struct reginst *in;
+	register const char *s = rp->input;
+	const char *save;
+
+	for (;;) {
+		if (vm->mark[i] == rp->gen)
+			return(n);
+		vm->mark[i] = rp->gen;
+		in = vm->inst + i;
+
+		switch (in->op) {
+		case I_CLASS:
+		case I_MATCH:
+			pc[n] = i;
+			memcpy((char *)(caps + n * vm->nslot), (char *)rp->cap,
+				vm->nslot * sizeof(char *));
+			return(n + 1);
+		case I_SPLIT:
+			n = regadd(rp, pc, caps, n, in->x);
+			i = in->y;
+			continue;
+		case I_SAVE:
+			save = rp->cap[in->y];
+			rp->cap[in->y] = s;
+			n = regadd(rp, pc, caps, n, in->x);
+			rp->cap[in->y] = save;
+			return(n);
+		case I_BOL:
+			if (s != rp->bol)
+				return(n);
+			break;
+		case I_EOL:
+			if (*s != '\0')
+				return(n);
+			break;
+		case I_WORDA:
+			/* At a word character, after BOL or a nonword one. */
+			if (!ISWORD(UCHARAT(s)) ||
+			    (s > rp->bol && ISWORD(UCHARAT(s - 1))))
+				return(n);
+			break;
+		case I_WORDZ:
+			if (ISWORD(UCHARAT(s)))
+				return(n);
+			break;
+		}
+		i = in->x;
+	}
 }
 
 /*
@@ -0,0 +1,660 @@
+/*
+ * Copyright 1993-2002 Christopher Seiwald and Perforce Software, Inc.
+ *
+ * This file is part of Jam - see jam.c for Copyright information.
+ */
+
+/*
+ * remote.c - run commands on jamworker daemons, from $(JAMWORKERS)
+ *
+ * If $(JAMWORKERS) lists jamworker addresses (unix:/path for a Unix
+ * socket, host:port or just port for TCP), execcmd() hands commands
+ * to those workers rather than running them itself.  Each -j slot
+ * keeps a connection to one worker, the slots being dealt out among
+ * the workers in turn, so -j sets how many commands run at once over
+ * all of them.  If a worker can't be reached, that slot's commands
+ * run locally.
+ *
+ * Over the connection go requests and, once the command is done,
+ * responses.  Strings are sent as their length in decimal and a
+ * newline, followed by that many bytes; numbers as decimal and a
+ * newline.  A request is:
+ *
+ *	"jamworker 1\n"
+ *	cwd
+ *	number of environment strings, then each "NAME=value"
+ *	number of input files ($(>)), then each name
+ *	number of output files ($(<)), then each name
+ *	the command
+ *
+ * The worker runs the command with /bin/sh -c in the cwd and
+ * environment given (saying which inputs it couldn't find, should the
+ * command fail), and responds:
+ *
+ *	exit code (-1 if the command was killed)
+ *	what the command wrote to stdout and stderr
+ *	number of output files, then for each its name, its mode, and
+ *	its size (-1 if it wasn't made) followed by its contents
+ *
+ * Jam prints the output and writes the output files it gets back,
+ * so a worker needn't share the file system the outputs go to; it
+ * must see the inputs under the same names, though.
+ *
+ * The response is read as it comes, whenever execwait() finds the
+ * connection readable, so a slow worker holds up no other commands;
+ * nothing is done with it until it's all there.  A worker can only
+ * send back the outputs it was asked for, in the order asked, and no
+ * string in a response may be longer than MAXRESP.
+ *
+ * External routines:
+ *
+ *	remote_init() - read $(JAMWORKERS), returning how many there are
+ *	remote_start() - send a command to the slot's worker
+ *	remote_done() - get a command's exit status, output and outputs
+ *
+ * Internal routines:
+ *
+ *	remote_connect() - connect to a worker
+ *	remote_close() - drop the connection to a slot's worker
+ *	remote_put() - append bytes to a request
+ *	remote_str() - append a string to a request
+ *	remote_num() - append a number to a request
+ *	remote_list() - append a count and a list of strings to a request
+ *	remote_parse() - go through a response, or act on it
+ *	remote_getnum() - take a number from a response
+ *	remote_getstr() - take a string from a response
+ *	remote_save() - write out an output file sent back
+ */
+
+# include "jam.h"
+# include "lists.h"
+# include "variable.h"
+# include "newstr.h"
+# include "remote.h"
+
+# ifdef unix
+# define USE_REMOTE
+# endif
+
+# ifdef USE_REMOTE
+
+# include <unistd.h>
+# include <fcntl.h>
+# include <errno.h>
+# include <signal.h>
+# include <sys/stat.h>
+# include <sys/socket.h>
+# include <sys/un.h>
+# include <netdb.h>
+
+# ifndef MSG_NOSIGNAL
+# define MSG_NOSIGNAL 0
+# endif
+
+extern char **environ;
+
+# define MAXRESP	( 1 << 28 )	/* longest string in a response */
+
+typedef struct {
+	char	*buf;
+	int	len;
+	int	size;
+} BUF ;
+
+typedef struct {
+	int		fd;	/* -1 if not connected, -2 if unreachable */
+	const char	*worker;
+	LIST		*outs;	/* $(<) of the command running */
+	BUF		resp;	/* its response, so far */
+} CONN ;
+
+static int nworkers = -1;
+static const char **workers = 0;
+static CONN *conns = 0;
+static int nconns = 0;
+static char cwd[ MAXJPATH ];
+
+static int remote_connect( const char *worker );
+static void remote_close( CONN *c );
+static void remote_put( BUF *b, const char *s, int len );
+static void remote_str( BUF *b, const char *s );
+static void remote_num( BUF *b, long n );
+static void remote_list( BUF *b, LIST *l );
+static int remote_parse( CONN *c, int act, int *code );
+static int remote_getnum( BUF *b, int *pos, long *n );
+static int remote_getstr( BUF *b, int *pos, const char **s, long *len );
+static int remote_save( const char *name, int mode, const char *data, long size );
+
+/*
+ * remote_init() - read $(JAMWORKERS), returning how many there are
+ *
+ * Only looks the first time.
+ */
+
+int
+remote_init()
+{
+	LIST *l;
+
+	if( nworkers >= 0 )
+	    return nworkers;
+
+	nworkers = 0;
+
+	for( l = var_get( "JAMWORKERS" ); l; l = list_next( l ) )
+	{
+	    workers = (const char **)realloc( (char *)workers,
+			( nworkers + 1 ) * sizeof( *workers ) );
+	    workers[ nworkers++ ] = copystr( l->string );
+	}
+
+	if( nworkers && !getcwd( cwd, sizeof( cwd ) ) )
+	{
+	    printf( "warning: can't get cwd for jamworkers\n" );
+	    nworkers = 0;
+	}
+
+	return nworkers;
+}
+
+/*
+ * remote_start() - send a command to the slot's worker
+ *
+ * Args are the command's $(<) and $(>).  Returns the connection to
+ * watch for the response, or -1 if the command must run locally.
+ */
+
+int
+remote_start(
+	int		slot,
+	const char	*string,
+	LOL		*args )
+{
+	CONN	*c;
+	BUF	b[1];
+	char	**e;
+	int	n, w;
+
+	if( remote_init() <= 0 || !args )
+	    return -1;
+
+	if( slot >= nconns )
+	{
+	    conns = (CONN *)realloc( (char *)conns, ( slot + 1 ) * sizeof( CONN ) );
+
+	    for( ; nconns <= slot; nconns++ )
+	    {
+		memset( (char *)&conns[ nconns ], '\0', sizeof( CONN ) );
+		conns[ nconns ].fd = -1;
+		conns[ nconns ].worker = workers[ nconns % nworkers ];
+	    }
+	}
+
+	c = &conns[ slot ];
+
+	if( c->fd == -2 )
+	    return -1;
+
+	if( c->fd < 0 )
+	{
+	    if( ( c->fd = remote_connect( c->worker ) ) < 0 )
+	    {
+		printf( "warning: can't reach jamworker %s, running locally\n",
+		    c->worker );
+		c->fd = -2;
+		return -1;
+	    }
+	}
+
+	/* Put the request together, and send it in one go. */
+
+	memset( (char *)b, '\0', sizeof( *b ) );
+
+	remote_put( b, "jamworker 1\n", 12 );
+	remote_str( b, cwd );
+
+	for( n = 0, e = environ; *e; e++ )
+	    n++;
+
+	remote_num( b, n );
+
+	for( e = environ; *e; e++ )
+	    remote_str( b, *e );
+
+	remote_list( b, lol_get( args, 1 ) );
+	remote_list( b, lol_get( args, 0 ) );
+	remote_str( b, string );
+
+	for( n = 0; n < b->len; n += w )
+	    if( ( w = send( c->fd, b->buf + n, b->len - n, MSG_NOSIGNAL ) ) <= 0 )
+		break;
+
+	free( b->buf );
+
+	/* Worker gone?  Run this one here; try again next time. */
+
+	if( n < b->len )
+	{
+	    remote_close( c );
+	    return -1;
+	}
+
+	/* Remember what may come back. */
+
+	c->outs = list_copy( L0, lol_get( args, 0 ) );
+	c->resp.len = 0;
+
+	return c->fd;
+}
+
+/*
+ * remote_done() - get a command's exit status, output and outputs
+ *
+ * Called when the slot's connection is readable (or, with wait, to
+ * wait for the whole response).  Takes what has come, and returns 0
+ * if there's more to come.  Otherwise, it prints the output, writes
+ * the outputs, sets *status to what wait() would have said about the
+ * command had it run locally, and returns 1.  A command whose outputs
+ * couldn't be written here fails.
+ */
+
+int
+remote_done(
+	int	slot,
+	int	wait,
+	int	*status )
+{
+	CONN	*c = &conns[ slot ];
+	BUF	*b = &c->resp;
+	int	n, code, r;
+
+	/* Take what's there, or with wait, until it's all there. */
+
+	for( ;; )
+	{
+	    /* The buffer grows up to a few of the longest strings. */
+
+	    if( b->size - b->len < 4096 )
+	    {
+		int size = b->size * 2 + 65536;
+		char *buf;
+
+		if( size > 4 * MAXRESP )
+		    size = 4 * MAXRESP;
+
+		if( size <= b->size || 
+		    !( buf = (char *)realloc( b->buf, size ) ) )
+			goto lost;
+
+		b->buf = buf;
+		b->size = size;
+	    }
+
+	    n = recv( c->fd, b->buf + b->len, b->size - b->len, 
+			wait ? 0 : MSG_DONTWAIT );
+
+	    if( n < 0 && errno == EINTR )
+		continue;
+
+	    if( n < 0 && errno == EAGAIN && !wait )
+		return 0;
+
+	    if( n <= 0 )
+		goto lost;
+
+	    b->len += n;
+
+	    if( ( r = remote_parse( c, 0, &code ) ) < 0 )
+		goto lost;
+
+	    if( r )
+		break;
+	}
+
+	/* All there: now act on it. */
+
+	remote_parse( c, 1, &code );
+
+	*status = code < 0 ? SIGKILL : ( code & 0xff ) << 8;
+
+	list_free( c->outs );
+	c->outs = 0;
+
+	return 1;
+
+    lost:
+	printf( "jamworker %s lost!\n", c->worker );
+	remote_close( c );
+	*status = SIGKILL;
+	return 1;
+}
+
+/*
+ * remote_parse() - go through a response, or act on it
+ *
+ * Without act, returns 1 if the whole response is there, 0 if not,
+ * or -1 if it's bad.  With act, prints the output and writes out the
+ * outputs, setting *code to the exit code to report.
+ */
+
+static int
+remote_parse(
+	CONN	*c,
+	int	act,
+	int	*code )
+{
+	BUF	*b = &c->resp;
+	LIST	*l = c->outs;
+	int	pos = 0;
+	long	ret, n, len, mode, size;
+	const char *s, *name;
+	int	r;
+
+	if( ( r = remote_getnum( b, &pos, &ret ) ) <= 0 ||
+	    ( r = remote_getstr( b, &pos, &s, &len ) ) <= 0 )
+		return r;
+
+	if( act )
+	    fwrite( s, 1, len, stdout );
+
+	if( ( r = remote_getnum( b, &pos, &n ) ) <= 0 )
+	    return r;
+
+	if( n != list_length( c->outs ) )
+	    return -1;
+
+	for( ; n-- > 0; l = list_next( l ) )
+	{
+	    if( ( r = remote_getstr( b, &pos, &name, &len ) ) <= 0 ||
+		( r = remote_getnum( b, &pos, &mode ) ) <= 0 ||
+		( r = remote_getnum( b, &pos, &size ) ) <= 0 )
+		    return r;
+
+	    /* Only what we asked for may be written. */
+
+	    if( len != strlen( l->string ) || memcmp( name, l->string, len ) )
+	    {
+		printf( "jamworker %s sent back %.*s, not %s\n", 
+		    c->worker, (int)len, name, l->string );
+		return -1;
+	    }
+
+	    if( size > MAXRESP || size < -1 )
+		return -1;
+
+	    if( size < 0 )
+		continue;
+
+	    if( pos + size > b->len )
+		return 0;
+
+	    if( act && !remote_save( l->string, (int)mode & 07777, 
+				     b->buf + pos, size ) && !ret )
+		ret = 1;
+
+	    pos += size;
+	}
+
+	*code = ret;
+
+	return 1;
+}
+
+/*
+ * remote_connect() - connect to a worker
+ */
+
+static int
+remote_connect( const char *worker )
+{
+	int fd = -1;
+
+	if( !strncmp( worker, "unix:", 5 ) )
+	{
+	    struct sockaddr_un addr;
+
+	    if( strlen( worker + 5 ) >= sizeof( addr.sun_path ) )
+		return -1;
+
+	    memset( (char *)&addr, '\0', sizeof( addr ) );
+	    addr.sun_family = AF_UNIX;
+	    strcpy( addr.sun_path, worker + 5 );
+
+	    if( ( fd = socket( AF_UNIX, SOCK_STREAM, 0 ) ) >= 0 &&
+		connect( fd, (struct sockaddr *)&addr, sizeof( addr ) ) < 0 )
+		    close( fd ), fd = -1;
+	}
+	else
+	{
+	    struct addrinfo hints, *res, *ai;
+	    char host[ MAXJPATH ];
+	    const char *port = strrchr( worker, ':' );
+
+	    /* host:port, or just port for this host */
+
+	    if( port && port - worker < sizeof( host ) )
+	    {
+		memcpy( host, worker, port - worker );
+		host[ port++ - worker ] = 0;
+	    }
+	    else
+	    {
+		strcpy( host, "localhost" );
+		port = worker;
+	    }
+
+	    memset( (char *)&hints, '\0', sizeof( hints ) );
+	    hints.ai_family = AF_UNSPEC;
+	    hints.ai_socktype = SOCK_STREAM;
+
+	    if( getaddrinfo( host, port, &hints, &res ) )
+		return -1;
+
+	    for( ai = res; ai && fd < 0; ai = ai->ai_next )
+		if( ( fd = socket( ai->ai_family, ai->ai_socktype,
+			ai->ai_protocol ) ) >= 0 &&
+		    connect( fd, ai->ai_addr, ai->ai_addrlen ) < 0 )
+			close( fd ), fd = -1;
+
+	    freeaddrinfo( res );
+	}
+
+	if( fd >= 0 )
+	    fcntl( fd, F_SETFD, FD_CLOEXEC );
+
+	return fd;
+}
+
+/*
+ * remote_close() - drop the connection to a slot's worker
+ */
+
+static void
+remote_close( CONN *c )
+{
+	if( c->fd >= 0 )
+	    close( c->fd );
+
+	list_free( c->outs );
+	c->outs = 0;
+	c->fd = -1;
+}
+
+/*
+ * remote_put() - append bytes to a request
+ */
+
+static void
+remote_put(
+	BUF		*b,
+	const char	*s,
+	int		len )
+{
+	if( b->len + len > b->size )
+	{
+	    b->size = ( b->len + len ) * 2 + 4096;
+	    b->buf = (char *)realloc( b->buf, b->size );
+	}
+
+	memcpy( b->buf + b->len, s, len );
+	b->len += len;
+}
+
+/*
+ * remote_str() - append a string to a request
+ */
+
+static void
+remote_str(
+	BUF		*b,
+	const char	*s )
+{
+	int len = strlen( s );
+
+	remote_num( b, len );
+	remote_put( b, s, len );
+}
+
+/*
+ * remote_num() - append a number to a request
+ */
+
+static void
+remote_num(
+	BUF	*b,
+	long	n )
+{
+	char buf[ 32 ];
+
+	remote_put( b, buf, sprintf( buf, "%ld\n", n ) );
+}
+
+/*
+ * remote_list() - append a count and a list of strings to a request
+ */
+
+static void
+remote_list(
+	BUF	*b,
+	LIST	*l )
+{
+	remote_num( b, list_length( l ) );
+
+	for( ; l; l = list_next( l ) )
+	    remote_str( b, l->string );
+}
+
+/*
+ * remote_getnum() - take a number from a response
+ *
+ * Returns 1 and moves *pos past it if it's there, 0 if it hasn't
+ * all come yet, and -1 if it isn't a number.
+ */
+
+static int
+remote_getnum(
+	BUF	*b,
+	int	*pos,
+	long	*n )
+{
+	char	buf[ 32 ];
+	int	i;
+
+	for( i = 0; *pos + i < b->len && b->buf[ *pos + i ] != '\n'; i++ )
+	    if( i == sizeof( buf ) - 1 )
+		return -1;
+
+	if( *pos + i == b->len )
+	    return 0;
+
+	memcpy( buf, b->buf + *pos, i );
+	buf[i] = 0;
+	*pos += i + 1;
+
+	return sscanf( buf, "%ld", n ) == 1 ? 1 : -1;
+}
+
+/*
+ * remote_getstr() - take a string from a response
+ *
+ * Like remote_getnum(); *s is left pointing into the response, and
+ * isn't null-terminated.
+ */
+
+static int
+remote_getstr(
+	BUF		*b,
+	int		*pos,
+	const char	**s,
+	long		*len )
+{
+	int	p = *pos;
+	int	r;
+
+	if( ( r = remote_getnum( b, &p, len ) ) <= 0 )
+	    return r;
+
+	if( *len < 0 || *len > MAXRESP )
+	    return -1;
+
+	if( p + *len > b->len )
+	    return 0;
+
+	*s = b->buf + p;
+	*pos = p + *len;
+
+	return 1;
+}
+
+/*
+ * remote_save() - write out an output file sent back
+ *
+ * Written to a temp file first and renamed, as it may be the very
+ * file the worker wrote, if it shares our file system.  Returns 0
+ * (having said why) if the file couldn't be written.
+ */
+
+static int
+remote_save(
+	const char	*name,
+	int		mode,
+	const char	*data,
+	long		size )
+{
+	char	tmp[ MAXJPATH ];
+	FILE	*f;
+	int	ok;
+
+	if( strlen( name ) + 16 > sizeof( tmp ) )
+	{
+	    printf( "can't write %s: name too long\n", name );
+	    return 0;
+	}
+
+	sprintf( tmp, "%s.jw%d", name, (int)getpid() );
+
+	if( !( f = fopen( tmp, "wb" ) ) )
+	{
+	    printf( "can't write %s\n", name );
+	    return 0;
+	}
+
+	ok = fwrite( data, 1, size, f ) == size;
+
+	if( fclose( f ) || !ok || chmod( tmp, mode ) || rename( tmp, name ) )
+	{
+	    printf( "can't write %s\n", name );
+	    unlink( tmp );
+	    return 0;
+	}
+
+	return 1;
+}
+
+# else
+
+int remote_init() { return 0; }
+int remote_start( int slot, const char *string, LOL *args ) { return -1; }
+int remote_done( int slot, int wait, int *status ) { return 1; }
+
+# endif /* USE_REMOTE */
@@ -7,6 +7,37 @@
 /*
  * timestamp.c - get the timestamp of a file or archive member
  *
+ * Files are found by listing their directories (and archives), once
+ * per directory: file_dirscan() enters every file there into the
+ * bindings table, to be time stamped as needed.
+ *
+ * On UNIX, if $(JAMDIRCACHE) names a file, the listings of directories
+ * are kept there from one run to the next.  Each is stored with the
+ * directory's device, inode and modification time, and used in place
+ * of listing the directory again as long as those haven't changed
+ * (as they do when files are added, removed or renamed).  The files'
+ * own times are not kept: they can change with the directory's staying
+ * the same, and so are looked up each run as before.  A directory that
+ * changed in the second it was listed isn't kept, as a later change in
+ * that same second wouldn't show.  A directory listed again with the
+ * same files as before doesn't by itself get the cache written: the
+ * one holding $(JAMDIRCACHE) changes every time it's written.
+ *
+ * External routines:
+ *
+ *	timestamp() - return timestamp on a file, if present
+ *	donestamps() - free timestamp tables, writing the directory cache
+ *
+ * Internal routines:
+ *
+ *	time_enter() - enter a file found by scanning into the bindings
+ *	time_scan() - list a directory, from the directory cache if it can
+ *	time_record() - note a file found by scanning, for the cache
+ *	dircache_same() - is a new listing the same as the cached one?
+ *	dircache_cmp() - compare file names, for qsort()
+ *	dircache_load() - read $(JAMDIRCACHE)
+ *	dircache_save() - write $(JAMDIRCACHE) back out
+ *
  * 09/22/00 (seiwald) - downshift names on OS2, too
  * 01/08/01 (seiwald) - closure param for file_dirscan/file_archscan
  * 11/04/02 (seiwald) - const-ing for string literals
@@ -18,6 +49,14 @@
 # include "pathsys.h"
 # include "timestamp.h"
 # include "newstr.h"
+# include "lists.h"
+# include "variable.h"
+
+# ifdef unix
+# define USE_DIRCACHE
+# include <unistd.h>
+# include <sys/stat.h>
+# endif
 
 /*
  * BINDING - all known files
@@ -44,6 +83,41 @@ struct _binding {
 
 static struct hash *bindhash = 0;
 static void time_enter( void *, const char *, int , time_t  );
+static void time_scan( const char *dir );
+
+# ifdef USE_DIRCACHE
+
+/*
+ * DIRCACHE - a directory's listing, as kept in $(JAMDIRCACHE)
+ */
+
+typedef struct _dircache DIRCACHE;
+
+struct _dircache {
+	const char	*name;
+	long		dev;
+	long		ino;
+	long		mtime;
+	int		keep;	/* listing good, to be saved */
+	int		nfiles;
+	int		size;
+	const char	**files;
+} ;
+
+static struct hash *dirhash = 0;
+static DIRCACHE **dirs = 0;	/* in order, for dircache_save() */
+static int ndirs = 0;
+static const char *dircachefile = 0;
+static int dirty = 0;
+
+static DIRCACHE *dircache_enter( const char *dir );
+static void time_record( void *, const char *, int, time_t );
+static int dircache_same( const char **files, int nfiles, DIRCACHE *d );
+static int dircache_cmp( const void *a, const void *b );
+static void dircache_load();
+static void dircache_save();
+
+# endif
 
 static const char *time_progress[] =
 {
@@ -79,7 +153,12 @@ timestamp(
 # endif 
 
 	if( !bindhash )
+	{
 	    bindhash = hashinit( sizeof( BINDING ), "bindings" );
+# ifdef USE_DIRCACHE
+	    dircache_load();
+# endif
+	}
 
 	/* Quick path - is it there? */
 
@@ -118,7 +197,7 @@ timestamp(
 
 	    if( !( b->flags & BIND_SCANNED ) )
 	    {
-		file_dirscan( buf, time_enter, bindhash );
+		time_scan( buf );
 		b->flags |= BIND_SCANNED;
 	    }
 	}
@@ -195,11 +274,314 @@ time_enter(
 }
 
 /*
- * donestamps() - free timestamp tables
+ * time_scan() - list a directory, from the directory cache if it can
+ */
+
+static void
+time_scan( const char *dir )
+{
+# ifdef USE_DIRCACHE
+	DIRCACHE *d;
+	struct stat st;
+	time_t now;
+	const char **was;
+	int i, nwas;
+
+	if( !dirhash || stat( *dir ? dir : ".", &st ) < 0 )
+	{
+	    file_dirscan( dir, time_enter, bindhash );
+	    return;
+	}
+
+	d = dircache_enter( dir );
+
+	if( d->keep &&
+	    d->dev == (long)st.st_dev && 
+	    d->ino == (long)st.st_ino &&
+	    d->mtime == (long)st.st_mtime )
+	{
+	    /* Unchanged: enter what was there last time. */
+
+	    if( DEBUG_BINDSCAN )
+		printf( "cached directory %s\n", dir );
+
+	    for( i = 0; i < d->nfiles; i++ )
+		time_enter( bindhash, d->files[i], 0, (time_t)0 );
+
+	    return;
+	}
+
+	/* New or changed: list it, noting what's there.  Only keep */
+	/* it if it can't have changed after we looked. */
+
+	now = time( 0 );
+
+	was = d->files;
+	nwas = d->keep ? d->nfiles : -1;
+
+	d->dev = (long)st.st_dev;
+	d->ino = (long)st.st_ino;
+	d->mtime = (long)st.st_mtime;
+	d->nfiles = d->size = 0;
+	d->files = 0;
+
+	file_dirscan( dir, time_record, d );
+
+	d->keep = st.st_mtime < now;
+
+	/* Only what was listed differently needs saving. */
+
+	if( !dircache_same( was, nwas, d ) )
+	    dirty++;
+
+	free( (char *)was );
+# else
+	file_dirscan( dir, time_enter, bindhash );
+# endif
+}
+
+# ifdef USE_DIRCACHE
+
+/*
+ * dircache_enter() - find or make the cache record for a directory
+ */
+
+static DIRCACHE *
+dircache_enter( const char *dir )
+{
+	DIRCACHE d, *dp = &d;
+
+	d.name = dir;
+
+	if( hashenter( dirhash, (HASHDATA **)&dp ) )
+	{
+	    dp->name = newstr( dir );
+	    dp->dev = dp->ino = dp->mtime = 0;
+	    dp->keep = 0;
+	    dp->nfiles = dp->size = 0;
+	    dp->files = 0;
+
+	    if( !( ndirs % 256 ) )
+		dirs = (DIRCACHE **)realloc( (char *)dirs,
+			( ndirs + 256 ) * sizeof( DIRCACHE * ) );
+
+	    dirs[ ndirs++ ] = dp;
+	}
+
+	return dp;
+}
+
+/*
+ * time_record() - note a file found by scanning, for the cache
+ */
+
+static void
+time_record( 
+	void		*closure,
+	const char	*target,
+	int		found,
+	time_t		time )
+{
+	DIRCACHE *d = (DIRCACHE *)closure;
+
+	if( d->nfiles == d->size )
+	{
+	    d->size = d->size ? d->size * 2 : 16;
+	    d->files = (const char **)realloc( (char *)d->files, 
+		    d->size * sizeof( char * ) );
+	}
+
+	d->files[ d->nfiles++ ] = newstr( target );
+
+	time_enter( bindhash, target, found, time );
+}
+
+/*
+ * dircache_same() - is a new listing the same as the cached one?
+ *
+ * Files may be listed in a different order; both lists are sorted
+ * to compare them.  Nfiles is -1 if there was no cached listing.
+ */
+
+static int
+dircache_same(
+	const char	**files,
+	int		nfiles,
+	DIRCACHE	*d )
+{
+	int i;
+
+	if( nfiles != d->nfiles )
+	    return 0;
+
+	qsort( (void *)files, nfiles, sizeof( char * ), dircache_cmp );
+	qsort( (void *)d->files, nfiles, sizeof( char * ), dircache_cmp );
+
+	for( i = 0; i < nfiles; i++ )
+	    if( strcmp( files[i], d->files[i] ) )
+		return 0;
+
+	return 1;
+}
+
+/*
+ * dircache_cmp() - compare file names, for qsort()
+ */
+
+static int
+dircache_cmp( 
+	const void	*a,
+	const void	*b )
+{
+	return strcmp( *(const char **)a, *(const char **)b );
+}
+
+/*
+ * dircache_load() - read $(JAMDIRCACHE)
+ *
+ * The file is plain text: a line for each directory,
+ *
+ *	d <tab> dev <tab> inode <tab> mtime <tab> count <tab> name
+ *
+ * followed by count lines, each a file in it as file_dirscan() gave
+ * it.  A directory missing any of its files is dropped.
+ */
+
+static void
+dircache_load()
+{
+	LIST	*l = var_get( "JAMDIRCACHE" );
+	char	buf[ MAXJPATH + 64 ];
+	DIRCACHE *d = 0;
+	int	n = 0;
+	FILE	*f;
+
+	if( !l || !*l->string )
+	    return;
+
+	dircachefile = copystr( l->string );
+	dirhash = hashinit( sizeof( DIRCACHE ), "dircache" );
+
+	if( !( f = fopen( dircachefile, "r" ) ) )
+	    return;
+
+	while( fgets( buf, sizeof( buf ), f ) )
+	{
+	    char *p = buf + strlen( buf );
+	    long dev, ino, mtime;
+	    int count, i = -1;
+
+	    if( p == buf || p[-1] != '\n' )
+		break;
+
+	    p[-1] = 0;
+
+	    /* The files of the directory before. */
+
+	    if( n )
+	    {
+		d->files[ d->nfiles++ ] = newstr( buf );
+
+		if( !--n )
+		    d->keep = 1;
+
+		continue;
+	    }
+
+	    if( sscanf( buf, "d\t%ld\t%ld\t%ld\t%d\t%n", 
+		    &dev, &ino, &mtime, &count, &i ) < 4 || 
+		i < 0 || count < 0 )
+		    continue;
+
+	    d = dircache_enter( buf + i );
+	    d->dev = dev;
+	    d->ino = ino;
+	    d->mtime = mtime;
+	    d->keep = !count;
+	    d->nfiles = 0;
+
+	    if( count > d->size )
+	    {
+		d->size = count;
+		d->files = (const char **)realloc( (char *)d->files,
+			d->size * sizeof( char * ) );
+	    }
+
+	    n = count;
+	}
+
+	fclose( f );
+
+	if( DEBUG_BINDSCAN )
+	    printf( "read %d directories from %s\n", ndirs, dircachefile );
+}
+
+/*
+ * dircache_save() - write $(JAMDIRCACHE) back out
+ *
+ * Written only if a directory had to be listed.  Directories this run
+ * didn't look at are kept, as another jam (say in a subdirectory) may
+ * want them.  Written to a temp file first and renamed, as jams run
+ * at once in different directories may share the file.
+ */
+
+static void
+dircache_save()
+{
+	char	tmp[ MAXJPATH ];
+	FILE	*f;
+	int	i, j;
+
+	if( !dirty || strlen( dircachefile ) + 16 > sizeof( tmp ) )
+	    return;
+
+	sprintf( tmp, "%s.%d", dircachefile, (int)getpid() );
+
+	if( !( f = fopen( tmp, "w" ) ) )
+	{
+	    printf( "warning: can't write %s\n", tmp );
+	    return;
+	}
+
+	for( i = 0; i < ndirs; i++ )
+	    if( dirs[i]->keep )
+	{
+	    DIRCACHE *d = dirs[i];
+
+	    /* Names with newlines can't be written. */
+
+	    for( j = 0; j < d->nfiles; j++ )
+		if( strchr( d->files[j], '\n' ) )
+		    break;
+
+	    if( j < d->nfiles || strchr( d->name, '\n' ) )
+		continue;
+
+	    fprintf( f, "d\t%ld\t%ld\t%ld\t%d\t%s\n",
+		d->dev, d->ino, d->mtime, d->nfiles, d->name );
+
+	    for( j = 0; j < d->nfiles; j++ )
+		fprintf( f, "%s\n", d->files[j] );
+	}
+
+	if( fclose( f ) || rename( tmp, dircachefile ) )
+	{
+	    printf( "warning: can't write %s\n", dircachefile );
+	    unlink( tmp );
+	}
+}
+
+# endif /* USE_DIRCACHE */
+
+/*
+ * donestamps() - free timestamp tables, writing the directory cache
  */
 
 void
 donestamps()
 {
+# ifdef USE_DIRCACHE
+	dircache_save();
+# endif
 	hashdone( bindhash );
 }